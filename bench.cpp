@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "include/planning_task.h"
+#include "include/planning_task_parser.h"
+#include "include/pq.h"
+#include "include/task_generator.h"
+
+#ifndef BENCH_SOURCE_DIR
+#define BENCH_SOURCE_DIR "."
+#endif
+
+/*
+    allocation counter: every operator new in the process goes through here,
+    so a kernel's allocations per op are the difference of two readings
+*/
+static unsigned long long n_allocs = 0;
+
+void *operator new(std::size_t size) {
+    n_allocs++;
+    void *p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](std::size_t size) {
+    n_allocs++;
+    void *p = std::malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::size_t) noexcept { std::free(p); }
+
+class BenchResult {
+   public:
+    std::string kernel;
+    std::string task;
+    long long iterations;
+    double ns_per_op;
+    double allocs_per_op;
+    double ops_per_sec;
+};
+
+/*
+    run op until min_time seconds have passed (at least min_iters times)
+    and report the average cost of a single call
+*/
+BenchResult run_kernel(const std::string &kernel, const std::string &task,
+                       double min_time, long long min_iters,
+                       const std::function<void()> &op) {
+    op();  // warm up caches and lazily built structures
+
+    long long iterations = 0;
+    unsigned long long allocs_before = n_allocs;
+    auto start = std::chrono::steady_clock::now();
+    double elapsed = 0;
+    while (iterations < min_iters || elapsed < min_time) {
+        op();
+        iterations++;
+        elapsed = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    }
+    unsigned long long allocs = n_allocs - allocs_before;
+
+    BenchResult res;
+    res.kernel = kernel;
+    res.task = task;
+    res.iterations = iterations;
+    res.ns_per_op = elapsed * 1e9 / iterations;
+    res.allocs_per_op = (double)allocs / iterations;
+    res.ops_per_sec = iterations / elapsed;
+    return res;
+}
+
+class PlanningTaskBench {
+   public:
+    static void run(PlanningTask &pt, const std::string &task,
+                    double min_time, std::vector<BenchResult> &results) {
+        State state = pt.get_initial_state();
+
+        results.push_back(run_kernel("h_max", task, min_time, 10, [&]() {
+            pt.reset_actions_metadata();
+            pt.compute_heuristic(state, 2);
+        }));
+
+        // unit cost h_max, whatever the metric of the task
+        results.push_back(
+            run_kernel("relaxed_planning_graph", task, min_time, 10, [&]() {
+                pt.reset_actions_metadata();
+                pt.rpg_heuristic(state);
+            }));
+
+        // one h_max per applicable action, batched with unit costs only (the
+        // per-candidate version is too slow on the larger tasks)
+        std::vector<int> possible;
+        if (pt.core->metric == 0) {
+            results.push_back(
+                run_kernel("look_ahead", task, min_time, 1, [&]() {
+                    pt.reset_actions_metadata();
+                    pt.compute_heuristic(state, 3);
+                    pt.get_possible_actions_idx(state, true, possible);
+                    pt.look_ahead(state, possible, 3);
+                }));
+        }
+
+        const char *names[] = {"backward_cost_propagation/min",
+                               "backward_cost_propagation/max",
+                               "backward_cost_propagation/sum"};
+        for (int h = 4; h <= 6; h++) {
+            results.push_back(
+                run_kernel(names[h - 4], task, min_time, 10, [&]() {
+                    pt.reset_actions_metadata();
+                    pt.backward_cost_propagation(state, h);
+                }));
+        }
+
+        // one op = one mutex check per action effect
+        results.push_back(
+            run_kernel("check_mutex_groups", task, min_time, 10, [&]() {
+                for (int to : pt.core->ops.effect_to)
+                    pt.check_mutex_groups(to, state);
+            }));
+
+        results.push_back(
+            run_kernel("get_possible_actions_idx", task, min_time, 10, [&]() {
+                pt.get_possible_actions_idx(state, true, possible);
+            }));
+
+        // one op = every successor of the state with its Zobrist key, as
+        // generated by ucs
+        pt.get_possible_actions_idx(state, true, possible);
+        uint64_t state_key = pt.core->facts_key(state);
+        State next = state;
+        results.push_back(
+            run_kernel("ucs successors", task, min_time, 10, [&]() {
+                for (int idx : possible) {
+                    next.words = state.words;
+                    uint64_t key = state_key;
+                    pt.compute_next_state(idx, next, &key);
+                }
+                pt.pending_effects.clear();
+            }));
+
+        // what every subproblem pays before it starts searching
+        results.push_back(run_kernel("copy PlanningTask", task, min_time, 10,
+                                     [&]() { PlanningTask sub(pt); }));
+    }
+};
+
+/*
+    one op = push n elements, lower the priority of every other one and pop
+    them all
+*/
+void run_pq(int n, double min_time, std::vector<BenchResult> &results) {
+    std::mt19937 gen(42);
+    std::vector<int> priorities(n);
+    for (int i = 0; i < n; i++)
+        priorities[i] = std::uniform_int_distribution<int>(0, 1000000)(gen);
+
+    PriorityQueue<int> pq(n);
+    results.push_back(run_kernel(
+        "PriorityQueue", "n=" + std::to_string(n), min_time, 10, [&]() {
+            for (int i = 0; i < n; i++) pq.push(i, priorities[i]);
+            for (int i = 0; i < n; i += 2) pq.change(i, priorities[i] / 2);
+            while (!pq.isEmpty()) pq.pop();
+        }));
+}
+
+void print_results(std::ostream &out, std::vector<BenchResult> &results) {
+    out << std::left << std::setw(34) << "kernel" << std::setw(28) << "task"
+        << std::right << std::setw(12) << "iters" << std::setw(16) << "ns/op"
+        << std::setw(14) << "allocs/op" << std::setw(16) << "ops/s"
+        << std::endl;
+    for (BenchResult &res : results) {
+        out << std::left << std::setw(34) << res.kernel << std::setw(28)
+            << res.task << std::right << std::setw(12) << res.iterations
+            << std::fixed << std::setprecision(1) << std::setw(16)
+            << res.ns_per_op << std::setw(14) << std::setprecision(2)
+            << res.allocs_per_op << std::setw(16) << std::setprecision(1)
+            << res.ops_per_sec << std::endl;
+    }
+}
+
+void print_usage(std::string executable) {
+    std::cerr << "Usage: " << executable
+              << " [--out <file_name>] [--min-time <float>] [--label "
+                 "<string>] [--quick] [--reorder] [<sas_file> ...]"
+              << std::endl;
+    std::cerr << "--reorder renumbers the .sas tasks as main --reorder 1"
+              << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::string out_file = "bench_output.txt";
+    std::string label;
+    double min_time = 0.5;
+    bool quick = false;
+    bool reorder = false;
+    std::vector<std::string> sas_files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--out" && i + 1 < argc) {
+            out_file = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            min_time = std::stod(argv[++i]);
+        } else if (arg == "--label" && i + 1 < argc) {
+            label = argv[++i];
+        } else if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--reorder") {
+            reorder = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            sas_files.push_back(arg);
+        }
+    }
+    if (quick) min_time = 0.05;
+
+    std::vector<BenchResult> results;
+    PlanningTaskParser parser;
+    parser.reorder = reorder;
+
+    sas_files.insert(sas_files.begin(),
+                     std::string(BENCH_SOURCE_DIR) + "/simple_example.sas");
+    for (std::string &file_name : sas_files) {
+        PlanningTask pt = parser.parse_from_file(file_name);
+        std::string task = file_name.substr(file_name.find_last_of('/') + 1);
+        std::cerr << "Benchmarking " << task << "..." << std::endl;
+        PlanningTaskBench::run(pt, task, min_time, results);
+    }
+
+    // generated tasks of growing size
+    TaskGenerator generator;
+    int sizes[][2] = {{100, 500}, {1000, 5000}};
+    for (int k = 0; k < (quick ? 1 : 2); k++) {
+        TaskGeneratorParams params;
+        params.n_vars = sizes[k][0];
+        params.n_actions = sizes[k][1];
+        params.max_range = 4;
+        params.max_preconds = 3;
+        params.cond_effect_prob = 0.1;
+        params.n_mutex = params.n_vars / 5;
+        PlanningTask pt = generator.generate(params);
+        std::string task = "generated_v" + std::to_string(params.n_vars) +
+                           "_a" + std::to_string(params.n_actions);
+        std::cerr << "Benchmarking " << task << "..." << std::endl;
+        PlanningTaskBench::run(pt, task, min_time, results);
+    }
+
+    run_pq(1000, min_time, results);
+    run_pq(100000, min_time, results);
+
+    print_results(std::cout, results);
+
+    std::ofstream out(out_file);
+    if (!out.is_open()) {
+        std::cerr << "Failed to open " << out_file << std::endl;
+        return 1;
+    }
+    std::time_t now = std::time(nullptr);
+    out << "# ai-planning microbenchmarks" << std::endl;
+    out << "# date: " << std::asctime(std::localtime(&now));
+    if (!label.empty()) out << "# label: " << label << std::endl;
+#ifdef NDEBUG
+    out << "# build: release" << std::endl;
+#else
+    out << "# build: debug (asserts enabled)" << std::endl;
+#endif
+    out << "# min time per kernel: " << min_time << " s" << std::endl;
+    print_results(out, results);
+    std::cerr << "Results written to " << out_file << std::endl;
+    return 0;
+}
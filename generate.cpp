@@ -0,0 +1,121 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "include/planning_task.h"
+#include "include/planning_task_utils.h"
+#include "include/task_generator.h"
+
+void print_usage(std::string executable) {
+    std::cerr << "Usage: " << executable
+              << " [--vars <int>] [--range <int>[:<int>]] [--actions <int>] "
+                 "[--preconds <int>[:<int>]] [--effects <int>] "
+                 "[--cond-effects <float>] [--effect-conds <int>] "
+                 "[--mutexes <int>] [--binding-mutexes <int>] "
+                 "[--mutex-size <int>] "
+                 "[--axiom-layers <int>] [--derived <int>] "
+                 "[--axioms-per-derived <int>] [--goals <int>] "
+                 "[--cost unit|uniform|bimodal] [--cost-range <int>:<int>] "
+                 "[--seed <int>] [--out <file_name>]"
+              << std::endl;
+    std::cerr << std::endl
+              << "Writes a solvable delete-free task in the translator "
+                 "format (stdout if no --out is given)"
+              << std::endl;
+}
+
+/*
+    parse "<int>" or "<int>:<int>" into [lower, upper]
+*/
+void parse_range(std::string arg, int &lower, int &upper) {
+    size_t sep = arg.find(':');
+    lower = std::stoi(arg.substr(0, sep));
+    upper = sep == std::string::npos ? lower : std::stoi(arg.substr(sep + 1));
+}
+
+int main(int argc, char **argv) {
+    TaskGeneratorParams params;
+    std::string out_file;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (arg == "--vars") {
+            params.n_vars = std::stoi(value);
+        } else if (arg == "--range") {
+            parse_range(value, params.min_range, params.max_range);
+        } else if (arg == "--actions") {
+            params.n_actions = std::stoi(value);
+        } else if (arg == "--preconds") {
+            parse_range(value, params.min_preconds, params.max_preconds);
+        } else if (arg == "--effects") {
+            params.max_effects = std::stoi(value);
+        } else if (arg == "--cond-effects") {
+            params.cond_effect_prob = std::stod(value);
+        } else if (arg == "--effect-conds") {
+            params.max_effect_conds = std::stoi(value);
+        } else if (arg == "--mutexes") {
+            params.n_mutex = std::stoi(value);
+        } else if (arg == "--binding-mutexes") {
+            params.n_binding_mutex = std::stoi(value);
+        } else if (arg == "--mutex-size") {
+            params.mutex_size = std::stoi(value);
+        } else if (arg == "--axiom-layers") {
+            params.n_axiom_layers = std::stoi(value);
+        } else if (arg == "--derived") {
+            params.derived_per_layer = std::stoi(value);
+        } else if (arg == "--axioms-per-derived") {
+            params.axioms_per_derived = std::stoi(value);
+        } else if (arg == "--goals") {
+            params.n_goals = std::stoi(value);
+        } else if (arg == "--cost") {
+            if (value == "unit")
+                params.cost_distribution = CostDistribution::unit;
+            else if (value == "uniform")
+                params.cost_distribution = CostDistribution::uniform;
+            else if (value == "bimodal")
+                params.cost_distribution = CostDistribution::bimodal;
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--cost-range") {
+            parse_range(value, params.min_cost, params.max_cost);
+        } else if (arg == "--seed") {
+            params.seed = std::stoul(value);
+        } else if (arg == "--out") {
+            out_file = value;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (params.n_vars < 1 || params.n_actions < 0 || params.max_effects < 1 ||
+        params.min_preconds > params.max_preconds ||
+        params.min_range > params.max_range ||
+        params.min_cost > params.max_cost || params.min_cost < 0 ||
+        params.derived_per_layer < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    TaskGenerator generator;
+    PlanningTask pt = generator.generate(params);
+
+    if (out_file.empty()) {
+        PlanningTaskUtils::write_sas(pt, std::cout);
+    } else {
+        std::ofstream out(out_file);
+        if (!out.is_open()) {
+            std::cerr << "Failed to open " << out_file << std::endl;
+            return 1;
+        }
+        PlanningTaskUtils::write_sas(pt, out);
+    }
+    return 0;
+}
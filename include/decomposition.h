@@ -0,0 +1,37 @@
+#ifndef DECOMPOSITION_H
+#define DECOMPOSITION_H
+
+#include <vector>
+
+#include "planning_task.h"
+
+/*
+    Goal decomposition on the causal graph. Two variables are linked when an
+    action or axiom reads one (precondition, condition or from value) and
+    writes the other, when one action writes both, or when they share a
+    mutex group. Goals in different connected components are independent:
+    no action of one component reads, writes or blocks a fact of another,
+    so each can be solved as a task of its own, from the same initial state,
+    and the plans concatenated.
+*/
+class GoalComponent {
+   public:
+    std::vector<Fact> goals;
+    std::vector<int> vars;
+    std::vector<int> actions;  // actions writing vars, by increasing index
+};
+
+// the components holding a goal, in the order of their first goal
+std::vector<GoalComponent> decompose_goals(const PlanningTask &pt);
+
+/*
+    solve (or solve_restarts with n_runs > 1) on every goal component, on
+    up to n_threads threads, the actions of the other components being
+    marked as used. The concatenated plan is validated on the whole task and
+    left in pt. With a single component, or when the concatenated plan does
+    not validate, pt is solved as a whole. Returns as solve_restarts
+*/
+int solve_decomposed(PlanningTask &pt, int seed, int heuristic, bool debug,
+                     int n_runs, int n_threads);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef HEURISTIC_CACHE_H
+#define HEURISTIC_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/*
+    Bounded table of heuristic values by 64-bit key (see
+    PlanningTask::heuristic_key), shared by the searches on one task,
+    threads included. It needs no lock: an entry is stored as key ^ data
+    next to data, so an entry torn by a concurrent store no longer matches
+    its key and reads as a miss.
+
+    With lru the table is split into buckets of bucket_size entries and a
+    new value replaces the least recently used entry of its bucket; with
+    always it is direct mapped and a new value replaces whatever was in its
+    slot.
+*/
+class HeuristicCache {
+   public:
+    enum Policy { lru, always };
+
+    static const int bucket_size = 4;
+
+    std::atomic<long long> n_hits{0}, n_misses{0}, n_stores{0};
+
+    HeuristicCache(long long bytes, Policy policy = lru);
+
+    bool find(uint64_t key, int &value);
+    void store(uint64_t key, int value);
+
+    long long bytes() const { return this->entries.size() * sizeof(Entry); }
+
+   private:
+    // data: value in the low 32 bits, last use in the high ones
+    class Entry {
+       public:
+        std::atomic<uint64_t> check{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    Policy policy;
+    std::vector<Entry> entries;
+    std::atomic<uint32_t> clock{0};
+
+    uint64_t first_slot(uint64_t key) const;
+    int n_slots() const { return this->policy == lru ? bucket_size : 1; }
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+/*
+    Accounting of the large search structures (ucs state store and frontier,
+    heuristic scratch, pending effects), shared by the tasks of a run.
+    Engines charge what they allocate and release it when done; a charge
+    that would exceed the limit is refused, so the engine can give up and
+    leave the incumbent to the caller instead of being killed by the OS.
+*/
+class MemoryBudget {
+   public:
+    long long limit = 0;  // bytes, 0 for no limit
+    long long used = 0;
+    long long peak = 0;
+    bool limit_reached = false;  // some charge was refused
+
+    // false (and nothing charged) if bytes do not fit in the limit
+    bool charge(long long bytes);
+    // memory needed anyway: charged even above the limit
+    void use(long long bytes);
+    void release(long long bytes);
+
+    static long long peak_resident();  // bytes, as reported by the OS
+};
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef PLAN_VALIDATOR_H
+#define PLAN_VALIDATOR_H
+
+#include <string>
+#include <vector>
+
+#include "planning_task.h"
+
+/*
+    Replays a plan with the semantics of PlanningTask::solve: before every
+    step the axioms are applied layer by layer and the pending effects are
+    retried, then the preconditions of the action are checked and its
+    effects are applied. An effect whose conditions or from value do not
+    hold, or whose fact is blocked by a mutex group, becomes pending.
+    Mutex groups keep a count of their true facts, so a step costs the size
+    of the action plus the pending effects (and the axioms, if any).
+
+    The goal is checked after the last step, once axioms and pending effects
+    have nothing left to apply.
+*/
+class PlanValidator {
+   public:
+    // outcome of the last validate call
+    bool valid;
+    int failed_step;    // plan index of the failing step, plan size for goals
+    std::string error;  // why the plan is not valid
+    int cost;           // cost of the plan (1 per action with metric 0)
+
+    PlanValidator(const TaskCore &core);
+
+    // plan holds action indices; with expected_cost != -1 the cost of the
+    // plan must match it
+    bool validate(const std::vector<int> &initial_state,
+                  const std::vector<Fact> &goal_state,
+                  const std::vector<int> &plan, int expected_cost = -1);
+
+   private:
+    const TaskCore *core;
+    std::vector<std::vector<int>> layer_axioms;  // axiom layer -> axioms
+
+    State state;
+    std::vector<int> mutex_n_true;  // true facts per mutex group
+    std::vector<int> pending;  // effect indices of core->ops
+
+    void add(int fact);
+    bool blocked(int fact);
+    bool holds(int fact);
+    bool try_effect(int e);
+    void apply_axioms();
+    int apply_pending_effects();
+    std::string fact_name(int fact);
+    bool fail(int step, const std::string &reason);
+};
+
+#endif
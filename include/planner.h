@@ -0,0 +1,99 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "heuristic_cache.h"
+#include "planning_task.h"
+#include "task_preprocessor.h"
+
+/*
+    algorithms by alg code: description in the usage and name printed when
+    running. A new algorithm only needs an entry in the table (planner.cpp)
+*/
+struct Algorithm {
+    const char *description;
+    const char *name;
+};
+
+extern const Algorithm algorithms[];
+extern const int n_algorithms;
+
+/*
+    Entry point of the planner library: a task is loaded once and solved any
+    number of times. solve is const and keeps all its state (search
+    metadata, memory accounting, deadline, random generator) in the call,
+    so concurrent solves on the same Planner are safe; they share the
+    read-only TaskCore.
+*/
+class PlannerOptions {
+   public:
+    int alg = 4;  // alg code, as in main
+    int seed = 0;
+    int restarts = 1;  // runs of the search, with seeds seed, seed + 1, ...
+    // threads solving the independent goal components (see decomposition.h),
+    // 0 to solve the task as a whole
+    int decompose = 0;
+    double time_limit = -1;  // seconds, -1 for none
+    // window of algs 7 and 8, as fractions of the plan (0 <= start < end <=
+    // 1); left at -1 and 2 the windows are chosen by select_windows
+    float start = -1, end = 2;
+    long long memory_limit = 0;  // bytes, 0 for none
+    bool debug = false;
+    std::ostream *log = nullptr;  // messages of the search, none if null
+    // algs 7 and 8: called from the solving thread with the plan of alg 4
+    // and every improvement of it (input file indices and cost)
+    std::function<void(const std::vector<int> &plan, int cost)> on_incumbent;
+};
+
+class PlannerResult {
+   public:
+    enum Status { solved, no_solution, time_limit };
+
+    // time_limit: plan holds the best solution found so far, if any
+    Status status;
+    std::vector<int> plan;  // action indices in the input file
+    std::vector<std::string> action_names;
+    int cost;  // -1 without a plan
+    int lower_bound;  // proved by alg 10 (cost if optimal), -1 otherwise
+    double seconds;
+    long long peak_memory;  // accounted bytes
+    bool memory_limit_reached;
+};
+
+class Planner {
+   public:
+    PlanningTask task;              // as loaded (and preprocessed)
+    TaskPreprocessor preprocessor;  // report of the last preprocessing
+    // h_max values shared by all the solves on the task, none if null
+    std::shared_ptr<HeuristicCache> heuristic_cache;
+
+    Planner() {}
+    // a copied PlanningTask starts without initial and goal state: share
+    // planners (e.g. through a shared_ptr) instead
+    Planner(const Planner &other) = delete;
+    Planner &operator=(const Planner &other) = delete;
+
+    // preprocess levels as in main (0 none, 1 unreachable and irrelevant
+    // parts, 2 also dominated actions), reorder as --reorder; throw
+    // std::runtime_error if the task cannot be read
+    void load_file(const std::string &file_name, int preprocess = 0,
+                   bool reorder = false);
+    void load_string(const std::string &sas, int preprocess = 0,
+                     bool reorder = false);
+    void enable_heuristic_cache(
+        long long bytes, HeuristicCache::Policy policy = HeuristicCache::lru);
+
+    // throws std::invalid_argument for an unknown alg or a bad window
+    PlannerResult solve(const PlannerOptions &options) const;
+
+   private:
+    void load(std::istream &file, int preprocess, bool reorder);
+};
+
+#endif
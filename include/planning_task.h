@@ -1,7 +1,12 @@
 #ifndef PLANNING_TASK_H
 #define PLANNING_TASK_H
 
+#include <chrono>
+#include <cstdint>
 #include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <string>
@@ -9,6 +14,9 @@
 #include <unordered_set>
 #include <vector>
 
+#include "pq.h"
+#include "rng.h"
+
 class Variable {
    public:
     std::string name;
@@ -21,9 +29,6 @@ class Fact {
    public:
     int var_idx;
     int var_val;
-    int hash() const {
-        return std::hash<int>{}(var_idx) ^ (std::hash<int>{}(var_val) << 1);
-    }
 
     // Define equality operator
     bool operator==(const Fact &other) const {
@@ -36,15 +41,12 @@ class Fact {
     }
 };
 
-// Custom hash function
-struct FactHasher {
-    int operator()(const Fact &f) const { return f.hash(); }
-};
-
 class MutexGroup {
    public:
     int n_facts;
     std::vector<Fact> facts;
+
+    std::vector<int> fact_ids;  // filled by TaskCore
 };
 
 class Effect {
@@ -54,19 +56,24 @@ class Effect {
     int var_affected;
     int from_value;
     int to_value;
+
+    // dense fact ids filled by TaskCore, -1 stands for "any value"
+    std::vector<int> cond_ids;
+    int from_id;
+    int to_id;
 };
 
 class Action {
    public:
-    std::string name;
+    std::string name;  // moved to TaskCore::names once the core is built
     int n_preconds;
     std::vector<Fact> preconds;
     int n_effects;
     std::vector<Effect> effects;
     int cost;
+    int original_idx;  // index in the input file, kept by preprocessing
 
-    bool is_used;  // this flag is 1 if the action is used in the plan
-    int h_cost;    // the heuristic cost of the action
+    std::vector<int> precond_ids;  // filled by TaskCore
 };
 
 class Axiom {
@@ -76,40 +83,226 @@ class Axiom {
     int affected_var;
     int from_value;
     int to_value;
+
+    // dense fact ids filled by TaskCore, -1 stands for "any value"
+    std::vector<int> cond_ids;
+    int from_id;
+    int to_id;
 };
 
-class IndexAction {
+/*
+    Delete-free state: the set of facts made true so far, one bit per dense
+    fact id
+*/
+class State {
    public:
-    int idx;
-    Action action;
+    std::vector<uint64_t> words;
+
+    State() {}
+    State(int n_facts) : words((n_facts + 63) / 64, 0) {}
+
+    bool has(int fact) const { return (words[fact >> 6] >> (fact & 63)) & 1; }
+    void add(int fact) { words[fact >> 6] |= uint64_t(1) << (fact & 63); }
 };
 
 class UcsNode {
    public:
-    std::string state;
+    uint64_t key;  // Zobrist key of the facts (TaskCore::facts_key)
     int parent_idx;
     int action_idx;
     int cost;
 };
 
-class PlanningTask {
+/*
+    The actions of a core in compressed rows (structure of arrays), which is
+    what the searches scan: the preconditions of action a are
+    precond_ids[precond_start[a], precond_start[a + 1]) and its effects the
+    indices [effect_start[a], effect_start[a + 1]) of the effect arrays. The
+    conditions of effect e are cond_ids[cond_start[e], cond_start[e + 1]),
+    without the "any value" ones; unconditional[e] is 1 if there are none.
+*/
+class OperatorTable {
+   public:
+    std::vector<int> cost;  // per action, as in the file
+    std::vector<int> precond_start, precond_ids;
+    std::vector<int> effect_start;
+
+    // per effect
+    std::vector<int> effect_action;
+    std::vector<int> effect_from;  // fact id, -1 for any value
+    std::vector<int> effect_to;
+    std::vector<char> unconditional;
+    std::vector<int> cond_start, cond_ids;
+
+    int n_preconds(int a) const {
+        return this->precond_start[a + 1] - this->precond_start[a];
+    }
+    int n_effects(int a) const {
+        return this->effect_start[a + 1] - this->effect_start[a];
+    }
+    bool conds_hold(int e, const State &state) const {
+        if (this->unconditional[e]) return true;
+        for (int k = this->cond_start[e]; k < this->cond_start[e + 1]; k++)
+            if (!state.has(this->cond_ids[k])) return false;
+        return true;
+    }
+};
+
+/*
+    Read-only part of a task: variables, mutexes, actions, axioms and the
+    lookup structures built on them. It is shared by every search on the task
+    (subproblems, restarts, workers), which only keep their own metadata.
+*/
+class TaskCore {
    public:
     int metric;  // 0 no action costs, 1 action costs
     int n_vars;
     std::vector<Variable> vars;
     int n_mutex;
     std::vector<MutexGroup> mutexes;
-    std::vector<int> initial_state;
-    int n_goals;
-    std::vector<Fact> goal_state;
     int n_actions;
-    std::vector<Action> actions;
+    std::vector<Action> actions;  // as parsed, names excepted
+    OperatorTable ops;
+    // action names, one after the other: the name of action a is
+    // names[name_start[a], name_start[a + 1])
+    std::string names;
+    std::vector<int> name_start;
     int n_axioms;
     std::vector<Axiom> axioms;
 
-    std::vector<IndexAction> solution;
+    // facts are numbered densely: the id of (var, val) is var_offset[var] +
+    // val, so that per-fact data lives in plain vectors
+    int n_facts;
+    std::vector<int> var_offset;
+    std::vector<Fact> facts;  // mapping index -> Fact
+    std::vector<std::vector<int>> precond_actions;  // fact id -> actions
+    std::vector<std::vector<int>> effect_actions;   // fact id -> actions
+    std::vector<std::vector<int>> fact_mutexes;     // fact id -> mutex groups
+    std::vector<int> actions_no_preconds;
+    int max_axiom_layer;
+
+    // Zobrist keys: the key of a set of facts (or actions) is the XOR of the
+    // keys of its members, so adding one costs an XOR
+    std::vector<uint64_t> fact_keys;
+    std::vector<uint64_t> action_keys;
+
+    TaskCore(int metric, int n_vars, std::vector<Variable> &vars, int n_mutex,
+             std::vector<MutexGroup> &mutexes, int n_actions,
+             std::vector<Action> &actions, int n_axioms,
+             std::vector<Axiom> &axioms);
+
+    int fact_id(int var, int val) const {
+        return val == -1 ? -1 : this->var_offset[var] + val;
+    }
+    int fact_id(const Fact &fact) const {
+        return fact_id(fact.var_idx, fact.var_val);
+    }
+    uint64_t facts_key(const State &state) const;
+    std::string action_name(int a) const {
+        int begin = this->name_start[a], end = this->name_start[a + 1];
+        return this->names.substr(begin, end - begin);
+    }
+
+   private:
+    void create_structs();
+    void create_operator_table();
+};
+
+class RelaxedPlanningGraph;
+class MemoryBudget;
+class HeuristicCache;
+
+/*
+    Buffers of a search, reused by every iteration instead of being allocated
+    again: they only grow, and are all freed with the search
+*/
+// achiever of a fact in the relaxed exploration of extract_relaxed_plan
+class RelaxedAchiever {
+   public:
+    int type;    // 0 action, 1 axiom, 2 pending effect
+    int idx;     // index of the action, axiom or pending effect
+    int effect;  // index in TaskCore::ops of the effect, -1 for axioms
+    int rank;    // achievers with a lower rank are preferred
+};
+
+class SearchScratch {
+   public:
+    std::vector<int> possible_actions;  // solve
+    std::vector<int> goals;             // fact ids of the goals
+    std::vector<int> cone;              // rpg_heuristic
+
+    // solve, alg 9
+    State before;
+    std::vector<int> relaxed_plan;
+
+    // h_max, weighted_h_max and propagate_costs
+    std::vector<int> fact_costs;
+    std::vector<char> cached, visited;
+    std::vector<int> missing;   // preconditions not reached, per action
+    std::vector<char> is_goal;  // per fact, all 0 between two calls
+    PriorityQueue<int> fact_queue;
+
+    // look_ahead
+    std::vector<State> successors;
+    std::vector<uint64_t> keys;
+    std::vector<int> costs, totals, to_evaluate;
+    std::vector<State> batch;
+
+    // extract_relaxed_plan
+    std::vector<int> layer, blocked, new_facts, action_layer, plan_pos;
+    std::vector<RelaxedAchiever> achiever;
+    std::vector<std::vector<int>> layer_facts;
+    std::vector<char> marked;
+    State reached;
+
+    // solve_restarts: the metadata every run starts from, and the best run
+    std::vector<char> start_is_used;
+    std::vector<int> start_pending, start_solution, best_solution;
+
+    SearchScratch(int n_facts)
+        : before(n_facts), fact_queue(n_facts), reached(n_facts) {}
+};
+
+class PlanningTask {
+   public:
+    std::shared_ptr<const TaskCore> core;
+    std::vector<int> initial_state;
+    int n_goals;
+    std::vector<Fact> goal_state;
+
+    // per-search metadata, indexed by action
+    std::vector<char> is_used;  // 1 if the action is used in the plan
+    // XOR of the action_keys of the used actions: set is_used through
+    // mark_used, or call reset_used_key after writing it (solve does)
+    uint64_t used_key = 0;
+    uint64_t state_key = 0;  // Zobrist key of the current state of solve
+    std::vector<int> h_cost;    // the heuristic cost of the action
+
+    std::vector<int> solution;  // indices of the applied actions, in order
     int solution_cost;
-    std::vector<Effect> pending_effects;
+    int proven_bound = 0;  // on the cost of a plan, by branch_and_bound
+    std::vector<int> pending_effects;  // effect indices of core->ops
+
+    // unit cost h_max, built on first use (scratch space, not copied)
+    std::shared_ptr<RelaxedPlanningGraph> rpg;
+    std::shared_ptr<SearchScratch> scratch;  // same
+
+    // accounting of the search structures, shared with the copies (none if
+    // null)
+    MemoryBudget *memory = nullptr;
+    // h_max values of look-ahead successors and lower bounds, shared with the
+    // copies and across threads (none if null)
+    HeuristicCache *heuristic_cache = nullptr;
+
+    // search settings, shared with the copies
+    std::ostream *log = nullptr;  // progress messages, none if null
+    bool has_deadline = false;
+    std::chrono::steady_clock::time_point deadline;
+
+    Rng rng;  // tie breaking, seeded by solve
+
+    // solve gives up once the plan costs at least this much
+    int cost_bound = std::numeric_limits<int>::max();
 
     PlanningTask() {}
 
@@ -120,52 +313,77 @@ class PlanningTask {
                  std::vector<Action> &actions, int n_axioms,
                  std::vector<Axiom> &axioms);
 
-    // Copy constructor
+    // Copy constructor: shares the core, starts a fresh search (initial and
+    // goal state are left to the caller)
     PlanningTask(const PlanningTask &other);
+    // Assignment copies the whole search, but not the scratch space
+    PlanningTask &operator=(const PlanningTask &other);
 
-    void print_solution();
-    bool check_integrity();
-    int solve(int seed, int heuristic, bool debug, int time_limit);
+    void mark_used(int idx);
+    void reset_used_key();
+    void print_solution(std::ostream &out = std::cout);
+    bool check_integrity(std::string *error = nullptr);
+    void set_time_limit(double seconds);  // deadline from now
+    bool deadline_passed() const;
+    // 0 solved, -1 no solution, -2 deadline passed, -3 cost_bound reached
+    int solve(int seed, int heuristic, bool debug);
+    // solve with seeds seed, seed + 1, ... for n_runs runs or until the
+    // deadline, keeping the cheapest plan: 0 if a plan was found, -1 if no
+    // run found one, -2 if the deadline passed before any plan
+    int solve_restarts(int seed, int heuristic, bool debug, int n_runs);
+    // 0 solved, 1 no solution, -1 node budget or memory limit reached, -2
+    // deadline passed
     int ucs();
+    // delete-free branch and bound on the actions of a plan (alg 10), from
+    // the plan in solution if incumbent: 0 if solution holds a plan (optimal
+    // if it costs proven_bound), -1 if none was found, -2 if the deadline
+    // passed before any plan
+    int branch_and_bound(bool incumbent);
+    int lower_bound();  // h_max of the initial state
+
+    static const int ucs_max_states = 500000;  // node budget of ucs
 
    private:
-    std::unordered_map<Fact, std::vector<int>, FactHasher> map_precond_actions;
-    std::unordered_map<Fact, std::vector<int>, FactHasher> map_effect_actions;
-    std::vector<Fact> facts;  // mapping index -> Fact
-    std::unordered_map<Fact, int, FactHasher> fact_to_index;
-    std::vector<int> actions_no_preconds;
+    friend class PlanningTaskBench;  // microbenchmarks drive private kernels
 
-    bool goal_reached(std::vector<std::unordered_set<int>> &current_state);
-    void apply_axioms(std::vector<std::unordered_set<int>> &current_state);
-    bool check_axiom_cond(Axiom axiom,
-                          std::vector<std::unordered_set<int>> &current_state);
-    bool check_mutex_groups(
-        int var_to_update, int new_value,
-        std::vector<std::unordered_set<int>> &current_state);
-    int get_max_axiom_layer();
-    std::vector<int> get_possible_actions_idx(
-        std::vector<std::unordered_set<int>> &current_state, bool check_usage);
-    int apply_action(int idx,
-                     std::vector<std::unordered_set<int>> &current_state);
-    int h_max(std::vector<std::unordered_set<int>> &current_state, Fact &fact,
-              std::unordered_set<int> &visited,
-              std::unordered_map<int, int> &cache);
-    int compute_heuristic(std::vector<std::unordered_set<int>> &current_state,
-                          int heuristic);
-    void remove_satisfied_actions(
-        std::vector<std::unordered_set<int>> &current_state,
-        std::vector<int> &possible_actions_idx);
+    bool charge_memory(long long bytes);  // refused above the limit
+    void use_memory(long long bytes);     // needed anyway, never refused
+    void release_memory(long long bytes);
+
+    uint64_t bound_key(uint64_t facts_key);  // goals only, no used action
+    uint64_t heuristic_key(uint64_t facts_key);
+    bool goal_reached(State &current_state);
+    // key, if given, is the Zobrist key of current_state: the facts added
+    // are XORed in (also by apply_pending_effects and get_initial_state)
+    void apply_axioms(State &current_state, uint64_t *key = nullptr);
+    bool check_axiom_cond(const Axiom &axiom, State &current_state);
+    bool check_mutex_groups(int fact, State &current_state);
+    SearchScratch &get_scratch();
+    // the applicable actions by increasing h_cost, in actions_idx
+    void get_possible_actions_idx(State &current_state, bool check_usage,
+                                  std::vector<int> &actions_idx);
+    int apply_action(int idx, State &current_state);
+    int h_max(State &current_state, int fact, std::vector<char> &visited,
+              std::vector<int> &cache, std::vector<char> &cached);
+    int compute_heuristic(State &current_state, int heuristic);
+    int rpg_heuristic(State &current_state);
+    int weighted_h_max(State &current_state);
+    void remove_satisfied_actions(State &current_state,
+                                  std::vector<int> &possible_actions_idx);
     void print_action_h_costs(std::vector<int> &actions_idx);
-    void create_structs();
     void reset_actions_metadata();
-    void backward_cost_propagation(
-        std::vector<std::unordered_set<int>> &current_state, int heuristic);
-    int apply_pending_effects(
-        std::vector<std::unordered_set<int>> &current_state);
-    void look_ahead(std::vector<std::unordered_set<int>> &current_state,
+    State get_initial_state(uint64_t *key = nullptr);
+    void backward_cost_propagation(State &current_state, int heuristic);
+    template <class Rule, bool unit_cost>
+    void propagate_costs(State &current_state);
+    int apply_pending_effects(State &current_state, uint64_t *key = nullptr);
+    void look_ahead(State &current_state,
                     std::vector<int> &possible_actions_idx, int heuristic);
-    int compute_next_state(int idx,
-                           std::vector<std::unordered_set<int>> &current_state);
+    // key, if given, is the Zobrist key of current_state: the facts added
+    // are XORed in
+    int compute_next_state(int idx, State &current_state,
+                           uint64_t *key = nullptr);
+    bool extract_relaxed_plan(State &current_state, std::vector<int> &plan);
 };
 
 #endif
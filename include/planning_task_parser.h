@@ -1,24 +1,36 @@
 #ifndef PLANNING_TASK_PARSER_H
 #define PLANNING_TASK_PARSER_H
 
+#include <istream>
 #include <vector>
 
 #include "planning_task.h"
+#include "task_preprocessor.h"
+#include "task_reorderer.h"
 
 class PlanningTaskParser {
    public:
-    PlanningTask parse_from_file(std::string filenamme);
+    TaskPreprocessor preprocessor;  // report of the last preprocessing
+    TaskReorderer reorderer;        // permutations of the last reordering
+    bool reorder = false;  // renumber the task for locality (after preprocess)
+
+    // preprocess: drop unreachable and irrelevant parts of the task (see
+    // TaskPreprocessor, configured through preprocessor)
+    PlanningTask parse_from_file(std::string filenamme,
+                                 bool preprocess = false);
+    // same, from a stream holding the task (e.g. a string in memory)
+    PlanningTask parse(std::istream &file, bool preprocess = false);
 
    private:
-    void assert_version(std::ifstream &file);
-    int get_metric(std::ifstream &file);
-    std::vector<Variable> get_variables(std::ifstream &file);
+    void assert_version(std::istream &file);
+    int get_metric(std::istream &file);
+    std::vector<Variable> get_variables(std::istream &file);
     Fact parse_fact(std::string line);
-    std::vector<MutexGroup> get_facts(std::ifstream &file);
-    std::vector<int> get_initial_state(std::ifstream &file, int n_vars);
-    std::vector<Fact> get_goal(std::ifstream &file);
-    std::vector<Action> get_actions(std::ifstream &file);
-    std::vector<Axiom> get_axioms(std::ifstream &file);
+    std::vector<MutexGroup> get_facts(std::istream &file);
+    std::vector<int> get_initial_state(std::istream &file, int n_vars);
+    std::vector<Fact> get_goal(std::istream &file);
+    std::vector<Action> get_actions(std::istream &file);
+    std::vector<Axiom> get_axioms(std::istream &file);
 };
 
 #endif
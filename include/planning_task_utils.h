@@ -1,9 +1,12 @@
 #ifndef PLANNING_TASK_UTILS_H
 #define PLANNING_TASK_UTILS_H
 
+#include <ostream>
+#include <string>
 #include <vector>
 
 #include "planning_task.h"
+#include "rng.h"
 
 namespace PlanningTaskUtils {
 void print_structure(PlanningTask &pt);
@@ -15,14 +18,17 @@ void print_planning_task_goal(PlanningTask &pt);
 void print_planning_task_actions(PlanningTask &pt);
 void print_planning_task_axioms(PlanningTask &pt);
 
-void print_var(Variable &var);
-void print_mutex(MutexGroup &mutex);
-void print_fact(Fact &fact);
-void print_action(Action &action);
-void print_effect(Effect &effect);
-void print_axiom(Axiom &axiom);
+void print_var(const Variable &var);
+void print_mutex(const MutexGroup &mutex);
+void print_fact(const Fact &fact);
+void print_action(const Action &action, const std::string &name);
+void print_effect(const Effect &effect);
+void print_axiom(const Axiom &axiom);
 
-int get_random_number(int lower, int upper);
+void write_sas(PlanningTask &pt, std::ostream &out);
+
+// uniform in [lower, upper)
+int get_random_number(Rng &rng, int lower, int upper);
 }  // namespace PlanningTaskUtils
 
 #endif
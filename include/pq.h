@@ -29,7 +29,7 @@ class PriorityQueue {
     bool has(int j) const { return (position[j] >= 0); }
     /** Clear content */
     void clear() {
-        std::fill(position.begin(), position.begin() + cnt, -1);
+        for (int k = 0; k < cnt; k++) position[data[k]] = -1;
         cnt = 0;
     }
     /** Restore heap structure */
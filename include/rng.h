@@ -0,0 +1,62 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+/*
+    xoshiro256** generator, owned by each search so that a seed gives the
+    same run whatever else runs in the process. The state is filled from the
+    seed with splitmix64. below(n) is unbiased (Lemire's multiply and
+    reject, which almost never needs a division).
+*/
+class Rng {
+   public:
+    typedef uint64_t result_type;
+
+    Rng(uint64_t seed = 0) { this->seed(seed); }
+
+    void seed(uint64_t seed) {
+        for (int i = 0; i < 4; i++) {
+            seed += 0x9e3779b97f4a7c15ull;
+            uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            this->s[i] = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t operator()() {
+        uint64_t result = rotl(this->s[1] * 5, 7) * 9;
+        uint64_t t = this->s[1] << 17;
+        this->s[2] ^= this->s[0];
+        this->s[3] ^= this->s[1];
+        this->s[1] ^= this->s[2];
+        this->s[0] ^= this->s[3];
+        this->s[2] ^= t;
+        this->s[3] = rotl(this->s[3], 45);
+        return result;
+    }
+
+    // uniform in [0, n), n > 0
+    uint32_t below(uint32_t n) {
+        uint64_t m = uint64_t(uint32_t((*this)() >> 32)) * n;
+        if (uint32_t(m) < n) {
+            uint32_t threshold = uint32_t(-n) % n;
+            while (uint32_t(m) < threshold)
+                m = uint64_t(uint32_t((*this)() >> 32)) * n;
+        }
+        return m >> 32;
+    }
+
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return ~uint64_t(0); }
+
+   private:
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef RPG_H
+#define RPG_H
+
+#include <cstdint>
+#include <vector>
+
+#include "planning_task.h"
+
+/*
+    Bit-parallel relaxed planning graph (preconditions only, like h_max).
+
+    A fact layer is a bitset over the dense fact ids. Every action keeps a
+    sparse precondition mask (the words it touches and the bits it needs in
+    each of them), so testing it against a layer is a few word-wide ANDs.
+    Only the actions having a precondition among the facts added by the last
+    layer are tested again. Dense layer operations use AVX2 when compiled
+    with it, plain 64 bit words otherwise.
+
+    With unit costs the level of a fact is its h_max value.
+
+    evaluate_batch runs the same layers for up to 64 states at once: every
+    fact and action keeps a word with one bit lane per state, so a sweep over
+    the actions serves all the states.
+*/
+class RelaxedPlanningGraph {
+   public:
+    static const int unreachable = -1;
+
+    std::vector<int> fact_level;    // first layer where the fact holds
+    std::vector<int> action_level;  // first layer where the action applies
+    int n_layers;
+
+    RelaxedPlanningGraph(const TaskCore &core);
+
+    // actions with is_used set are left out of the graph. The graph stops at
+    // the first layer containing all the goals (it is complete if goals is
+    // empty): later levels stay unreachable
+    void build(const State &state, const std::vector<char> &is_used,
+               const std::vector<int> &goals);
+
+    // actions reached going backwards from the goals through achievers and
+    // their preconditions, stopping at facts true in state
+    void backward_cone(const State &state, const std::vector<char> &is_used,
+                       const std::vector<int> &goals,
+                       std::vector<int> &actions);
+
+    // level of the goal layer (max goal level) of each of the n_states <= 64
+    // states, std::numeric_limits<int>::max() if some goal is unreachable
+    void evaluate_batch(const State *states, int n_states,
+                        const std::vector<char> &is_used,
+                        const std::vector<int> &goals, int *totals);
+
+    static const int batch_size = 64;
+
+   private:
+    const TaskCore *core;
+    int n_words;
+
+    // the mask of action a is [mask_begin[a], mask_begin[a + 1])
+    std::vector<int> mask_begin;
+    std::vector<int> mask_word;
+    std::vector<uint64_t> mask_bits;
+
+    // the added facts of action a are [add_begin[a], add_begin[a + 1])
+    std::vector<int> add_begin;
+    std::vector<int> add_fact;
+
+    // the preconditions of action a are [pre_begin[a], pre_begin[a + 1])
+    std::vector<int> pre_begin;
+    std::vector<int> pre_fact;
+
+    // scratch buffers, reused by every build
+    std::vector<uint64_t> layer, next_layer, added;
+    std::vector<int> candidates;
+    std::vector<int> candidate_stamp;
+    std::vector<uint64_t> visited_facts;
+    std::vector<char> visited_actions;
+    std::vector<int> stack;
+    std::vector<uint64_t> fact_lanes, pending_lanes, action_lanes;
+    std::vector<int> touched, changed;
+
+    bool applicable(int action);
+};
+
+#endif
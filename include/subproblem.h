@@ -0,0 +1,72 @@
+#ifndef SUBPROBLEM_H
+#define SUBPROBLEM_H
+
+#include <functional>
+#include <vector>
+
+#include "planning_task.h"
+
+/*
+    Re-optimisation of a plan window (algs 7 and 8): the actions in
+    [start, end) of a solution are replaced by the solution of the subproblem
+    going from the state before start to the facts needed after end.
+*/
+
+// multi-valued application of an action, as used to build subproblems
+void compute_next_state(PlanningTask &pt, int action_idx,
+                        std::vector<int> &current_state);
+
+PlanningTask create_subproblem(PlanningTask &orig, int start, int end);
+
+// sub.solution becomes original.solution with [start, end) replaced by
+// sub.solution (and sub.solution_cost its cost)
+void merge_solutions(int start, int end, PlanningTask &original,
+                     PlanningTask &sub);
+
+class Window {
+   public:
+    int start, end;          // actions [start, end) of the solution
+    int cost;                // cost of those actions
+    int lower_bound;         // h_max of the subproblem, -1 if unknown
+    double predicted_nodes;  // states the ucs is expected to generate
+
+    // subproblem of the window, as create_subproblem builds it
+    std::vector<int> initial_state;
+    std::vector<Fact> goal_state;
+    std::vector<int> pending_effects;
+};
+
+/*
+    Splits the solution of pt into consecutive windows, each as long as the
+    ucs is predicted to stay within node_budget states, and returns those
+    that fit the budget and may be improved (cost above the h_max lower
+    bound of their subproblem, or a bound h_max cannot give), the largest
+    slack first. The subproblems come from a single replay of the solution.
+
+    Only the actions in the backward cone of the goals of a window can be
+    part of its plan, and alg 8 searches with those alone. With b of them
+    applicable at the start, the prediction takes every subset of them as a
+    state: the ones costing less than the window, and half of those costing
+    as much, are expanded, each generating b states. On windows of generated
+    tasks, this is above the states the ucs generates 95% of the time, by a
+    factor of 4 in the median.
+*/
+std::vector<Window> select_windows(PlanningTask &pt, double node_budget);
+
+/*
+    algs 7 (alg 4 again) and 8 (ucs) on the solution of pt, with sub as the
+    subproblem: reoptimise_window takes the window [p_start, p_end), as
+    fractions of the solution, reoptimise_windows the ones of select_windows.
+    Messages and the final solution go to pt.log, the best solution is left
+    in pt, and on_improved is called whenever it improves. They return 0, 1
+    if the window is empty or -2 if the deadline of pt passed (the incumbent
+    is printed)
+*/
+int reoptimise_window(PlanningTask &pt, PlanningTask &sub, int alg, int seed,
+                      bool debug, float p_start, float p_end,
+                      const std::function<void()> &on_improved = nullptr);
+int reoptimise_windows(PlanningTask &pt, PlanningTask &sub, int alg,
+                       int seed, bool debug,
+                       const std::function<void()> &on_improved = nullptr);
+
+#endif
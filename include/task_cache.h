@@ -0,0 +1,46 @@
+#ifndef TASK_CACHE_H
+#define TASK_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "planner.h"
+
+/*
+    Loaded tasks by content, for processes solving many requests: a file is
+    read and hashed on every request, but only parsed and preprocessed when
+    its hash, preprocess level and reordering are not among the capacity
+    most recently used ones. Planners are shared: an evicted one lives on as
+    long as a solve still uses it.
+*/
+class TaskCache {
+   public:
+    int n_hits = 0, n_misses = 0;
+    long long heuristic_cache_bytes = 0;  // per loaded task, none if 0
+
+    TaskCache(size_t capacity);
+
+    // hit tells whether the task was already loaded; throws as
+    // Planner::load_file
+    std::shared_ptr<const Planner> get(const std::string &file_name,
+                                       int preprocess, bool reorder,
+                                       bool &hit);
+
+    static uint64_t hash(const std::string &bytes);  // FNV-1a
+
+   private:
+    typedef std::pair<std::string, std::shared_ptr<const Planner>> Entry;
+
+    size_t capacity;
+    std::mutex mutex;
+    std::list<Entry> entries;  // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+};
+
+#endif
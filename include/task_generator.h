@@ -0,0 +1,80 @@
+#ifndef TASK_GENERATOR_H
+#define TASK_GENERATOR_H
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "planning_task.h"
+
+enum class CostDistribution {
+    unit,     // metric 0, every action costs 1
+    uniform,  // uniform in [min_cost, max_cost]
+    bimodal   // mostly in [min_cost, max_cost], some 10 times more expensive
+};
+
+class TaskGeneratorParams {
+   public:
+    int n_vars = 50;
+    int min_range = 2;  // domain size of each variable in [min_range,
+    int max_range = 2;  // max_range]
+    int n_actions = 200;
+    int min_preconds = 0;
+    int max_preconds = 2;
+    int max_effects = 2;
+    double cond_effect_prob = 0;  // probability of an effect having conditions
+    int max_effect_conds = 1;
+    int n_mutex = 0;  // groups that never block (see TaskGenerator)
+    int n_binding_mutex = 0;  // groups that do
+    int mutex_size = 3;
+    int n_axiom_layers = 0;
+    int derived_per_layer = 2;  // derived variables in each axiom layer
+    int axioms_per_derived = 2;
+    int n_goals = 5;
+    CostDistribution cost_distribution = CostDistribution::uniform;
+    int min_cost = 1;
+    int max_cost = 10;
+    unsigned int seed = 42;
+};
+
+/*
+    Generates random delete-free tasks that are solvable by construction:
+    actions are created one after the other and only require facts produced
+    by the initial state, by earlier actions or by earlier axiom layers, so
+    applying them in creation order reaches every goal.
+
+    Plain mutex groups contain a single reachable fact, the rest are values
+    no action produces, so they never block an update. Binding mutex groups
+    hold reachable facts with different first producers, which block each
+    other. Their facts are taken off the constructed plan: the first
+    producers of the goals, recursively of their preconditions and effect
+    conditions, and the axioms of the derived goals never need them.
+*/
+class TaskGenerator {
+   public:
+    PlanningTask generate(const TaskGeneratorParams &params);
+
+   private:
+    std::mt19937 gen;
+    std::vector<Variable> vars;
+    std::vector<std::vector<bool>> reached;  // [var][val]
+    // [var][val]: first action producing the fact, -1 if none
+    std::vector<std::vector<int>> producer;
+    std::vector<Fact> reached_facts;
+
+    int random_int(int lower, int upper);  // in [lower, upper]
+    void reach(Fact fact);
+    std::vector<Fact> sample_reached_facts(int n);
+    int sample_cost(const TaskGeneratorParams &params);
+    Action generate_action(int i, const TaskGeneratorParams &params);
+    std::vector<Axiom> generate_axiom_layer(int layer,
+                                            const TaskGeneratorParams &params);
+    std::vector<std::vector<bool>> plan_facts(
+        const std::vector<Fact> &goal_state, const std::vector<Action> &actions,
+        const std::vector<Axiom> &axioms);
+    std::vector<MutexGroup> generate_binding_mutexes(
+        const TaskGeneratorParams &params, const std::vector<Fact> &goal_state,
+        const std::vector<Action> &actions, const std::vector<Axiom> &axioms);
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef TASK_PREPROCESSOR_H
+#define TASK_PREPROCESSOR_H
+
+#include <ostream>
+#include <vector>
+
+#include "planning_task.h"
+
+/*
+    Reachability and relevance analysis run on the parsed task, before the
+    TaskCore is built.
+
+    Facts that cannot be reached from the initial state under delete
+    relaxation are removed, together with the actions, effects and axioms
+    requiring them. Actions with no effect in the backward relevance closure
+    of the goals are removed as well. Axioms fire on their own, so they are
+    only removed if nothing kept depends on them: their outcome is not
+    relevant, in no mutex group and no condition of a kept effect or axiom.
+    With remove_dominated, an action is also removed when another one has a
+    subset of its preconditions, a superset of its effects and no higher
+    cost, as long as the extra effects can neither block a mutex group nor
+    trigger an axiom (of identical actions the first one is kept).
+    The passes are repeated until nothing changes, then variables and values
+    are renumbered compactly.
+
+    Every plan of the reduced task is a plan of the original one: the removed
+    actions are never applied and the kept ones produce the same states.
+    Actions keep their index in the input file in original_idx.
+*/
+class TaskPreprocessor {
+   public:
+    bool remove_dominated = false;  // also drop duplicate/dominated actions
+
+    // report
+    bool goal_unreachable;
+    int n_actions_before, n_actions_after;
+    int n_unreachable_actions, n_irrelevant_actions;
+    int n_duplicate_actions, n_dominated_actions;
+    int n_axioms_before, n_axioms_after;
+    int n_unreachable_axioms, n_irrelevant_axioms;
+    int n_vars_before, n_vars_after;
+    int n_facts_before, n_facts_after;
+    int n_mutex_before, n_mutex_after;
+
+    void run(int metric, std::vector<Variable> &vars,
+             std::vector<MutexGroup> &mutexes, std::vector<int> &initial_state,
+             std::vector<Fact> &goal_state, std::vector<Action> &actions,
+             std::vector<Axiom> &axioms);
+    void print_report(std::ostream &out);
+
+   private:
+    int n_facts;
+    std::vector<int> var_offset;
+
+    // a unit adds its target fact once all its conditions hold: there is one
+    // unit per action effect (preconditions, effect conditions and from
+    // value) and one per axiom (conditions and from value)
+    int n_units;
+    std::vector<std::vector<int>> unit_conds;
+    std::vector<int> unit_target;
+    std::vector<int> unit_owner;  // action index, or n_actions + axiom index
+    std::vector<int> fact_var;
+    std::vector<std::vector<int>> fact_watchers;   // fact -> units needing it
+    std::vector<std::vector<int>> fact_achievers;  // fact -> units adding it
+    std::vector<char> in_mutex;                    // per fact
+
+    std::vector<char> alive;                        // per owner
+    std::vector<char> reached, relevant;            // per fact
+    std::vector<char> unit_reached, unit_relevant;  // per unit
+
+    int fact_id(const Fact &fact);
+    void build_units(std::vector<Variable> &vars, std::vector<Action> &actions,
+                     std::vector<Axiom> &axioms);
+    void compute_reachability(std::vector<int> &initial_state);
+    void compute_relevance(std::vector<Fact> &goal_state);
+    std::vector<char> select_axioms(int n_actions);
+    bool remove_dominated_actions(int metric, std::vector<Action> &actions);
+    void compact(std::vector<Variable> &vars, std::vector<MutexGroup> &mutexes,
+                 std::vector<int> &initial_state, std::vector<Fact> &goal_state,
+                 std::vector<Action> &actions, std::vector<Axiom> &axioms);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef TASK_REORDERER_H
+#define TASK_REORDERER_H
+
+#include <vector>
+
+#include "planning_task.h"
+
+/*
+    Renumbering of variables (and so of the dense fact ids, which follow
+    the variables) and actions for memory locality, run on the parsed task
+    before the TaskCore is built.
+
+    The order is a breadth-first visit of the variable-action graph in the
+    direction backward_cost_propagation walks it: from the goal variables to
+    the actions changing them, then to the variables of their preconditions
+    and effects. Variables and actions are numbered as they are reached, so
+    an action and the facts it reads and writes get nearby ids; the parts
+    not reached from the goals are visited the same way afterwards, in input
+    order. Axioms keep their order.
+
+    The renumbered task has the same plans: actions keep their index in the
+    input file in original_idx, and var_order maps the variables back.
+*/
+class TaskReorderer {
+   public:
+    // permutations of the last run: new index -> index before the run
+    std::vector<int> var_order;
+    std::vector<int> action_order;
+
+    void run(std::vector<Variable> &vars, std::vector<MutexGroup> &mutexes,
+             std::vector<int> &initial_state, std::vector<Fact> &goal_state,
+             std::vector<Action> &actions, std::vector<Axiom> &axioms);
+
+   private:
+    void compute_order(int n_vars, const std::vector<Fact> &goal_state,
+                       const std::vector<Action> &actions,
+                       const std::vector<Axiom> &axioms);
+};
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+    Fixed set of threads running the submitted jobs in order of submission
+*/
+class WorkerPool {
+   public:
+    WorkerPool(int n_workers);
+    ~WorkerPool();  // runs the queued jobs, then joins the workers
+
+    void submit(std::function<void()> job);
+    void wait();  // until no job is queued or running
+
+   private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> jobs;
+    int n_running = 0;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable job_ready, idle;
+
+    void run();
+};
+
+#endif
@@ -1,112 +1,80 @@
 #include <algorithm>
 #include <csignal>
+#include <cstdlib>
 #include <iostream>
 #include <string>
+#include <vector>
 
+#include "include/decomposition.h"
+#include "include/heuristic_cache.h"
+#include "include/memory_budget.h"
+#include "include/planner.h"
 #include "include/planning_task.h"
 #include "include/planning_task_parser.h"
 #include "include/planning_task_utils.h"
+#include "include/subproblem.h"
 
 void print_usage(std::string executable) {
     std::cerr << "Usage: " << executable
               << " --from-file <file_name> --alg <alg_code> --seed <int> "
                  "[--timelimit <int>] --debug <bool> [--start <float>] [--end "
-                 "<float>]"
+                 "<float>] [--preprocess <int>] [--memory-limit <MB>] "
+                 "[--restarts <int>] [--heuristic-cache <MB>] [--cache-policy "
+                 "lru|always] [--reorder <bool>] [--decompose <threads>]"
               << std::endl;
+    std::cerr << std::endl << "Supported alg_code are:" << std::endl;
+    for (int i = 0; i < n_algorithms; i++)
+        std::cerr << i << ": " << algorithms[i].description << std::endl;
     std::cerr << std::endl
-              << "Supported alg_code are:" << std::endl
-              << "0: random" << std::endl
-              << "1: greedy" << std::endl
-              << "2: greedy + pruning" << std::endl
-              << "3: h_max + lookahead" << std::endl
-              << "4: backward cost propagation (min)" << std::endl
-              << "5: backward cost propagation (max)" << std::endl
-              << "6: backward cost propagation (sum)" << std::endl
-              << "7: re-apply alg 4" << std::endl;
-}
-
-void compute_next_state(PlanningTask& pt, int action_idx,
-                        std::vector<int>& current_state) {
-    for (int i = 0; i < pt.actions[action_idx].n_effects; i++) {
-        Effect effect = pt.actions[action_idx].effects[i];
-        int j;
-        for (j = 0; j < effect.n_effect_conds; j++) {
-            Fact effect_cond = effect.effect_conds[j];
-            if (current_state[effect_cond.var_idx] != effect_cond.var_val &&
-                effect_cond.var_val != -1)
-                break;
-        }
-        if (j < effect.n_effect_conds) {  // the effect cannot be applied
-            pt.pending_effects.push_back(effect);
-            continue;
-        }
-        int var = effect.var_affected;
-        if (current_state[var] == effect.from_value ||
-            effect.from_value == -1) {
-            current_state[var] = effect.to_value;
-        } else {
-            pt.pending_effects.push_back(effect);
-        }
-    }
-}
-
-void merge_solutions(int start, int end, PlanningTask& original,
-                     PlanningTask& sub) {
-    for (int i = start - 1; i >= 0; i--) {
-        sub.solution.insert(sub.solution.begin(), original.solution[i]);
-        sub.solution_cost +=
-            (sub.metric == 1) ? original.actions[original.solution[i].idx].cost
-                              : 1;
-        sub.actions[original.solution[i].idx].is_used =
-            true;  // mark them as used
-    }
-    for (int i = end; i < original.solution.size(); i++) {
-        sub.solution.push_back(original.solution[i]);
-        sub.solution_cost +=
-            (sub.metric == 1) ? original.actions[original.solution[i].idx].cost
-                              : 1;
-        sub.actions[original.solution[i].idx].is_used =
-            true;  // mark them as used
-    }
-}
-
-PlanningTask create_subproblem(PlanningTask& orig, int start, int end) {
-    PlanningTask sub(orig);
-    std::vector<int> current_state = orig.initial_state;
-
-    // new initial_state = state after applying action at start
-    int i = 0;
-    for (; i < end; i++) {
-        if (i == start) sub.initial_state = current_state;
-        int idx = orig.solution[i].idx;
-        compute_next_state(sub, idx, current_state);
-    }
-
-    // new goal_state = goal state facts up to end + preconditions of following
-    // actions
-    std::unordered_set<int> required_vars;
-    for (int j = end; j < orig.solution.size(); ++j) {
-        for (const Fact& pre : orig.solution[j].action.preconds) {
-            required_vars.insert(pre.var_idx);
-        }
-    }
-    for (const Fact& goal_fact : orig.goal_state) {
-        required_vars.insert(goal_fact.var_idx);
-    }
-
-    for (int k = 0; k < current_state.size(); ++k)
-        if (sub.initial_state[k] != current_state[k] &&
-            required_vars.count(k))  // add only facts that are not already
-                                     // present in the initial state
-            sub.goal_state.push_back({k, current_state[k]});
-
-    sub.n_goals = sub.goal_state.size();
-    return sub;
+              << "Supported preprocess levels are:" << std::endl
+              << "0: none" << std::endl
+              << "1: remove unreachable and irrelevant parts" << std::endl
+              << "2: as 1, and duplicate or dominated actions" << std::endl;
+    std::cerr << std::endl
+              << "Without --start and --end, algs 7 and 8 choose the plan "
+                 "windows to re-optimise"
+              << std::endl;
+    std::cerr << "With --restarts n, the search (alg 4 for algs 7 and 8) runs "
+                 "with seeds seed, ..., seed + n - 1, or until the timelimit, "
+                 "and keeps the cheapest plan"
+              << std::endl;
+    std::cerr << "--heuristic-cache keeps the h_max values of states (look-"
+                 "ahead of alg 3, window bounds of algs 7 and 8) across the "
+                 "steps and restarts"
+              << std::endl;
+    std::cerr << "--decompose solves the goals depending on disjoint parts "
+                 "of the task (causal graph components) separately, on up to "
+                 "the given number of threads, and concatenates the plans"
+              << std::endl;
+    std::cerr << "--reorder renumbers variables and actions so that the ones "
+                 "used together are close in memory; plans keep the action "
+                 "indices of the file"
+              << std::endl;
+    std::cerr << "Alg 10 searches the sets of actions for an optimal plan, "
+                 "pruned by the plan of alg 4, until the timelimit, and "
+                 "prints the lower bound proved and the gap"
+              << std::endl;
 }
 
 PlanningTask pt, sub;
 bool solving_sub = false;
 bool solved_main = false;
+MemoryBudget memory;
+HeuristicCache *heuristic_cache = nullptr;
+
+// run summary on stderr, so that the last line of stdout stays the cost
+void print_memory_report() {
+    std::cerr << "Peak memory: " << memory.peak / (1024 * 1024)
+              << " MB accounted, "
+              << MemoryBudget::peak_resident() / (1024 * 1024)
+              << " MB resident";
+    if (memory.limit_reached) std::cerr << " (memory limit reached)";
+    std::cerr << std::endl;
+    if (heuristic_cache)
+        std::cerr << "Heuristic cache: " << heuristic_cache->n_hits
+                  << " hits, " << heuristic_cache->n_misses << " misses, "
+                  << heuristic_cache->n_stores << " stores" << std::endl;
+}
 
 void signal_handler(int signum) {
     std::cout << "Timelimit reached" << std::endl;
@@ -139,6 +107,12 @@ int main(int argc, char** argv) {
     int debug;
     float p_start = -1;
     float p_end = 2;
+    int preprocess = 0;
+    int restarts = 1;
+    bool reorder = false;
+    int decompose = 0;
+    long long cache_bytes = 0;
+    HeuristicCache::Policy cache_policy = HeuristicCache::lru;
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
         if (arg == "--from-file") {
@@ -167,16 +141,40 @@ int main(int argc, char** argv) {
         if (arg == "--end") {
             p_end = std::stof(argv[++i]);
         }
+        if (arg == "--preprocess") {
+            preprocess = std::stoi(argv[++i]);
+        }
+        if (arg == "--memory-limit") {
+            memory.limit = std::stoll(argv[++i]) * 1024 * 1024;
+        }
+        if (arg == "--restarts") {
+            restarts = std::stoi(argv[++i]);
+        }
+        if (arg == "--decompose") {
+            decompose = std::stoi(argv[++i]);
+        }
+        if (arg == "--reorder") {
+            reorder = std::stoi(argv[++i]);
+        }
+        if (arg == "--heuristic-cache") {
+            cache_bytes = std::stoll(argv[++i]) * 1024 * 1024;
+        }
+        if (arg == "--cache-policy") {
+            std::string policy = argv[++i];
+            cache_policy = policy == "always" ? HeuristicCache::always
+                                              : HeuristicCache::lru;
+        }
     }
 
     if (!(from_file_flag && alg_flag && seed_flag && debug_flag) || alg < 0 ||
-        alg > 8) {
+        alg >= n_algorithms || restarts < 1 || decompose < 0) {
         print_usage(argv[0]);
         return 1;
     }
 
     if (!time_limit_flag) time_limit = -1;
-    if ((alg == 7 || alg == 8) &&
+    bool adaptive = (alg == 7 || alg == 8) && p_start == -1 && p_end == 2;
+    if ((alg == 7 || alg == 8) && !adaptive &&
         (p_start < 0 || p_end > 1 || p_start >= p_end)) {
         print_usage(argv[0]);
         std::cerr << std::endl
@@ -185,50 +183,48 @@ int main(int argc, char** argv) {
     }
 
     PlanningTaskParser parser;
-    pt = parser.parse_from_file(file_name);
+    parser.preprocessor.remove_dominated = preprocess >= 2;
+    parser.reorder = reorder;
+    pt = parser.parse_from_file(file_name, preprocess);
+    pt.memory = &memory;
+    pt.log = &std::cout;
+    if (cache_bytes) {
+        heuristic_cache = new HeuristicCache(cache_bytes, cache_policy);
+        pt.heuristic_cache = heuristic_cache;
+    }
+    if (time_limit != -1) pt.set_time_limit(time_limit);
+    std::atexit(print_memory_report);
     std::cout << "File " << file_name << " parsed!" << std::endl << std::endl;
+    if (preprocess) {
+        std::cout << "############ Preprocessing ##############" << std::endl;
+        parser.preprocessor.print_report(std::cout);
+        std::cout << std::endl;
+    }
     std::cout << "############ File structure #############" << std::endl;
     PlanningTaskUtils::print_structure(pt);
 
     std::cout << std::endl << "Running algorithm: ";
 
-    switch (alg) {
-        case 0:
-            std::cout << "random" << std::endl;
-            break;
-        case 1:
-            std::cout << "greedy" << std::endl;
-            break;
-        case 2:
-            std::cout << "greedy + pruning" << std::endl;
-            break;
-        case 3:
-            std::cout << "hmax + lookahead" << std::endl;
-            break;
-        case 4:
-            std::cout << "backward cost propagation (min)" << std::endl;
-            break;
-        case 5:
-            std::cout << "backward cost propagation (max)" << std::endl;
-            break;
-        case 6:
-            std::cout << "backward cost propagation (sum)" << std::endl;
-            break;
-        case 7:
-            std::cout << "reapply backward cost propagation (min)" << std::endl;
-            break;
-        case 8:
-            std::cout << "backward cost propagation (min) + ucs" << std::endl;
-            break;
-    }
+    std::cout << algorithms[alg].name << std::endl;
 
     std::cout << "Solving..." << std::endl;
-    int res = (alg == 7 || alg == 8) ? pt.solve(seed, 4, debug, time_limit)
-                                     : pt.solve(seed, alg, debug, time_limit);
+    int heuristic = (alg == 7 || alg == 8 || alg == 10) ? 4 : alg;
+    int res;
+    if (decompose)
+        res = solve_decomposed(pt, seed, heuristic, debug, restarts, decompose);
+    else if (restarts > 1)
+        res = pt.solve_restarts(seed, heuristic, debug, restarts);
+    else
+        res = pt.solve(seed, heuristic, debug);
+    if (alg == 10 && res != -2) res = pt.branch_and_bound(res == 0);
+    if (res == -2) {
+        std::cout << "Timelimit reached" << std::endl;
+        return 1;
+    }
     if (!res) {
         solved_main = true;
         std::cout << "Solution found!" << std::endl;
-        if (alg < 7) {
+        if (alg != 7 && alg != 8) {
             std::cout << std::endl
                       << "############### Solution ###############"
                       << std::endl;
@@ -239,75 +235,12 @@ int main(int argc, char** argv) {
     }
 
     if ((alg == 7 || alg == 8) && !res) {
-        int start = pt.solution.size() * p_start;
-        int end = pt.solution.size() * p_end;
-        if (start >= end) {
-            std::cout << std::endl
-                      << "Degenerate subproblem: start >= end" << std::endl;
-            std::cout << "Returning original solution" << std::endl;
-            std::cout << std::endl
-                      << "############### Solution ###############"
-                      << std::endl;
-            pt.print_solution();
-            return 1;
-        }
-
-        std::cout << std::endl << "Solving subproblem..." << std::endl;
         solving_sub = true;
-        sub = create_subproblem(pt, start, end);
-
-        int section_cost = 0;
-        for (int i = start; i < end; i++) {
-            section_cost += pt.solution[i].action.cost;
-        }
-        std::cout << "Original subproblem cost: " << section_cost << std::endl;
-
-        int res_sub;
-        if (alg == 7)
-            res_sub = sub.solve(seed, 4, debug, time_limit);
-        else
-            res_sub = sub.ucs();
-
-        if (!res_sub) {
-            std::cout << std::endl
-                      << "############### Sub-Problem Solution ###############"
-                      << std::endl;
-            sub.print_solution();
-
-            // merge sub-solution with the original one
-            merge_solutions(start, end, pt, sub);
-            if (sub.solution_cost < pt.solution_cost) {
-                std::cout << "Improved solution found!" << std::endl;
-                std::cout << std::endl
-                          << "############### Solution ###############"
-                          << std::endl;
-                sub.print_solution();
-            } else {
-                std::cout << "No improvements. Returning original solution"
-                          << std::endl;
-                std::cout << std::endl
-                          << "############### Solution ###############"
-                          << std::endl;
-                pt.print_solution();
-            }
-
-            if (debug) {
-                sub.initial_state = pt.initial_state;
-                sub.goal_state = pt.goal_state;
-                if (sub.check_integrity())
-                    std::cout << "Integrity check passed!" << std::endl;
-                else
-                    std::cout << "Integrity check NOT passed!" << std::endl;
-            }
-        }
-        if (res_sub && alg == 8) {
-            std::cout << "UCS: too many nodes. Returning original solution"
-                      << std::endl;
-            std::cout << std::endl
-                      << "############### Solution ###############"
-                      << std::endl;
-            pt.print_solution();
-        }
+        int res_sub =
+            adaptive
+                ? reoptimise_windows(pt, sub, alg, seed, debug)
+                : reoptimise_window(pt, sub, alg, seed, debug, p_start, p_end);
+        return res_sub == -2 ? 1 : res_sub;
     }
     return 0;
 }
@@ -0,0 +1,256 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <functional>
+#include <vector>
+
+#include "include/planner.h"
+#include "include/task_cache.h"
+#include "include/worker_pool.h"
+
+void print_usage(std::string executable) {
+    std::cerr << "Usage: " << executable
+              << " [--socket <path>] [--workers <int>] [--cache <int>] "
+                 "[--heuristic-cache <MB>]"
+              << std::endl;
+    std::cerr << std::endl
+              << "Solves one request per line, read from stdin or from every "
+                 "connection to the Unix socket:"
+              << std::endl
+              << "<id> --from-file <file_name> --alg <alg_code> [--seed <int>] "
+                 "[--timelimit <float>] [--debug <bool>] [--start <float>] "
+                 "[--end <float>] [--preprocess <int>] [--memory-limit <MB>] "
+                 "[--restarts <int>] [--reorder <bool>] [--decompose <int>]"
+              << std::endl
+              << "and answers with lines starting with the id:" << std::endl
+              << "<id> incumbent cost <int> plan <action_idx>..." << std::endl
+              << "<id> solved|no_solution|time_limit cost <int> time <float> "
+                 "cache hit|miss [bound <int>] plan <action_idx>..."
+              << std::endl
+              << "<id> error <message>" << std::endl;
+}
+
+/*
+    Where the answers to a client go (stdout or a connection), one whole line
+    at a time. The connection is closed with the last reference, once the
+    client is gone and its requests are answered
+*/
+class Client {
+   public:
+    int fd;
+    bool owned;  // the connection is closed with the client
+    std::mutex mutex;
+
+    Client(int fd, bool owned) : fd(fd), owned(owned) {}
+    ~Client() {
+        if (this->owned) close(this->fd);
+    }
+
+    void send(const std::string &line) {
+        std::string data = line + "\n";
+        std::lock_guard<std::mutex> lock(this->mutex);
+        for (size_t done = 0; done < data.size();) {
+            ssize_t n = ::send(this->fd, data.data() + done,
+                               data.size() - done, MSG_NOSIGNAL);
+            if (n < 0 && errno == ENOTSOCK)
+                n = write(this->fd, data.data() + done, data.size() - done);
+            if (n <= 0) return;  // the client is gone
+            done += n;
+        }
+    }
+};
+
+class Request {
+   public:
+    std::string id;
+    std::string file_name;
+    int preprocess = 0;
+    bool reorder = false;
+    PlannerOptions options;
+};
+
+// flags as in main; throws std::invalid_argument on a bad request
+Request parse_request(const std::string &line) {
+    std::istringstream ss(line);
+    Request request;
+    ss >> request.id;
+    std::string arg, value;
+    while (ss >> arg) {
+        if (!(ss >> value))
+            throw std::invalid_argument("missing value for " + arg);
+        if (arg == "--from-file")
+            request.file_name = value;
+        else if (arg == "--alg")
+            request.options.alg = std::stoi(value);
+        else if (arg == "--seed")
+            request.options.seed = std::stoi(value);
+        else if (arg == "--timelimit")
+            request.options.time_limit = std::stod(value);
+        else if (arg == "--debug")
+            request.options.debug = value == "1" || value == "true";
+        else if (arg == "--start")
+            request.options.start = std::stof(value);
+        else if (arg == "--end")
+            request.options.end = std::stof(value);
+        else if (arg == "--restarts")
+            request.options.restarts = std::stoi(value);
+        else if (arg == "--preprocess")
+            request.preprocess = std::stoi(value);
+        else if (arg == "--decompose")
+            request.options.decompose = std::stoi(value);
+        else if (arg == "--reorder")
+            request.reorder = value == "1" || value == "true";
+        else if (arg == "--memory-limit")
+            request.options.memory_limit = std::stoll(value) * 1024 * 1024;
+        else
+            throw std::invalid_argument("unknown flag " + arg);
+    }
+    if (request.file_name.empty())
+        throw std::invalid_argument("missing --from-file");
+    return request;
+}
+
+std::string plan_line(const std::vector<int> &plan) {
+    std::string line = " plan";
+    for (int idx : plan) line += " " + std::to_string(idx);
+    return line;
+}
+
+const char *status_names[] = {"solved", "no_solution", "time_limit"};
+
+void handle(const std::string &line, std::shared_ptr<Client> client,
+            TaskCache &cache) {
+    std::string id = line.substr(0, line.find(' '));
+    try {
+        Request request = parse_request(line);
+        bool hit;
+        std::shared_ptr<const Planner> planner =
+            cache.get(request.file_name, request.preprocess, request.reorder,
+                      hit);
+        request.options.on_incumbent = [&](const std::vector<int> &plan,
+                                           int cost) {
+            client->send(id + " incumbent cost " + std::to_string(cost) +
+                         plan_line(plan));
+        };
+        PlannerResult result = planner->solve(request.options);
+        client->send(id + " " + status_names[result.status] + " cost " +
+                     std::to_string(result.cost) + " time " +
+                     std::to_string(result.seconds) + " cache " +
+                     (hit ? "hit" : "miss") +
+                     (result.lower_bound == -1
+                          ? ""
+                          : " bound " + std::to_string(result.lower_bound)) +
+                     plan_line(result.plan));
+    } catch (const std::exception &e) {
+        client->send(id + " error " + e.what());
+    }
+}
+
+// one request per line from in, until the client closes its side
+void read_requests(int in, std::shared_ptr<Client> client, WorkerPool &pool,
+                   TaskCache &cache) {
+    std::string pending;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(in, buffer, sizeof(buffer))) > 0) {
+        pending.append(buffer, n);
+        size_t end;
+        while ((end = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, end);
+            pending.erase(0, end + 1);
+            if (line.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            pool.submit([line, client, &cache]() {
+                handle(line, client, cache);
+            });
+        }
+    }
+}
+
+std::string socket_path;
+
+void signal_handler(int signum) {
+    if (!socket_path.empty()) unlink(socket_path.c_str());
+    _exit(signum);
+}
+
+int main(int argc, char **argv) {
+    int n_workers = std::thread::hardware_concurrency();
+    int cache_size = 8;
+    long long heuristic_cache_bytes = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        if (arg == "--socket") {
+            socket_path = argv[++i];
+        } else if (arg == "--workers") {
+            n_workers = std::stoi(argv[++i]);
+        } else if (arg == "--cache") {
+            cache_size = std::stoi(argv[++i]);
+        } else if (arg == "--heuristic-cache") {
+            heuristic_cache_bytes = std::stoll(argv[++i]) * 1024 * 1024;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (n_workers < 1) n_workers = 1;
+    if (cache_size < 0) cache_size = 0;
+
+    TaskCache cache(cache_size);
+    cache.heuristic_cache_bytes = heuristic_cache_bytes;
+    WorkerPool pool(n_workers);
+
+    if (socket_path.empty()) {
+        // stdin: answer everything, then exit
+        read_requests(STDIN_FILENO,
+                      std::make_shared<Client>(STDOUT_FILENO, false), pool,
+                      cache);
+        pool.wait();
+        return 0;
+    }
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path too long" << std::endl;
+        return 1;
+    }
+    strcpy(address.sun_path, socket_path.c_str());
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path.c_str());
+    if (server < 0 || bind(server, (sockaddr *)&address, sizeof(address)) ||
+        listen(server, 64)) {
+        std::cerr << "Failed to listen on " << socket_path << ": "
+                  << strerror(errno) << std::endl;
+        return 1;
+    }
+    signal(SIGTERM, signal_handler);
+    signal(SIGINT, signal_handler);
+    std::cerr << "Listening on " << socket_path << " with " << n_workers
+              << " workers" << std::endl;
+
+    while (true) {
+        int fd = accept(server, nullptr, nullptr);
+        if (fd < 0) continue;
+        std::thread(read_requests, fd, std::make_shared<Client>(fd, true),
+                    std::ref(pool), std::ref(cache))
+            .detach();
+    }
+}
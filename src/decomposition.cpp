@@ -0,0 +1,161 @@
+#include "../include/decomposition.h"
+
+#include <algorithm>
+#include <numeric>
+#include <ostream>
+#include <vector>
+
+#include "../include/memory_budget.h"
+#include "../include/plan_validator.h"
+#include "../include/worker_pool.h"
+
+std::vector<GoalComponent> decompose_goals(const PlanningTask &pt) {
+    const TaskCore &core = *pt.core;
+    std::vector<int> parent(core.n_vars);
+    std::iota(parent.begin(), parent.end(), 0);
+    auto find = [&](int var) {
+        while (parent[var] != var) var = parent[var] = parent[parent[var]];
+        return var;
+    };
+    auto unite = [&](int a, int b) { parent[find(a)] = find(b); };
+
+    // the arcs of the causal graph, as undirected links
+    const OperatorTable &ops = core.ops;
+    auto var_of = [&](int fact) { return core.facts[fact].var_idx; };
+    for (int a = 0; a < core.n_actions; a++) {
+        if (!ops.n_effects(a)) continue;
+        int var = var_of(ops.effect_to[ops.effect_start[a]]);
+        for (int j = ops.precond_start[a]; j < ops.precond_start[a + 1]; j++)
+            unite(var_of(ops.precond_ids[j]), var);
+        for (int e = ops.effect_start[a]; e < ops.effect_start[a + 1]; e++) {
+            unite(var_of(ops.effect_to[e]), var);
+            for (int k = ops.cond_start[e]; k < ops.cond_start[e + 1]; k++)
+                unite(var_of(ops.cond_ids[k]), var);
+        }
+    }
+    for (const Axiom &axiom : core.axioms)
+        for (const Fact &cond : axiom.conds)
+            unite(cond.var_idx, axiom.affected_var);
+    for (const MutexGroup &mutex : core.mutexes)
+        for (const Fact &f : mutex.facts)
+            unite(f.var_idx, mutex.facts[0].var_idx);
+
+    std::vector<GoalComponent> components;
+    std::vector<int> component(core.n_vars, -1);  // by root
+    for (const Fact &goal : pt.goal_state) {
+        int &k = component[find(goal.var_idx)];
+        if (k == -1) {
+            k = components.size();
+            components.emplace_back();
+        }
+        components[k].goals.push_back(goal);
+    }
+    for (int var = 0; var < core.n_vars; var++) {
+        int k = component[find(var)];
+        if (k != -1) components[k].vars.push_back(var);
+    }
+    for (int a = 0; a < core.n_actions; a++) {
+        if (!ops.n_effects(a)) continue;
+        int k = component[find(var_of(ops.effect_to[ops.effect_start[a]]))];
+        if (k != -1) components[k].actions.push_back(a);
+    }
+    return components;
+}
+
+int solve_decomposed(PlanningTask &pt, int seed, int heuristic, bool debug,
+                     int n_runs, int n_threads) {
+    auto solve_whole = [&]() {
+        return n_runs > 1 ? pt.solve_restarts(seed, heuristic, debug, n_runs)
+                          : pt.solve(seed, heuristic, debug);
+    };
+    std::vector<GoalComponent> components = decompose_goals(pt);
+    if (pt.log)
+        *pt.log << "Goal components: " << components.size() << std::endl;
+    if (components.size() <= 1) return solve_whole();
+
+    // one search per component; their memory is accounted apart, as the
+    // budget is not shared between threads, and added up afterwards
+    int n = components.size();
+    std::vector<PlanningTask> subs;
+    subs.reserve(n);
+    std::vector<MemoryBudget> budgets(n);
+    std::vector<int> results(n);
+    for (int k = 0; k < n; k++) {
+        subs.emplace_back(pt);
+        PlanningTask &sub = subs.back();
+        sub.initial_state = pt.initial_state;
+        sub.goal_state = components[k].goals;
+        sub.n_goals = sub.goal_state.size();
+        sub.is_used.assign(pt.core->n_actions, true);
+        for (int a : components[k].actions) sub.is_used[a] = false;
+        sub.reset_used_key();
+        sub.log = nullptr;
+        if (pt.memory) {
+            budgets[k].limit = pt.memory->limit;
+            sub.memory = &budgets[k];
+        }
+    }
+    auto run = [&](int k) {
+        PlanningTask &sub = subs[k];
+        results[k] = n_runs > 1
+                         ? sub.solve_restarts(seed, heuristic, debug, n_runs)
+                         : sub.solve(seed, heuristic, debug);
+    };
+    if (n_threads > 1) {
+        WorkerPool pool(std::min(n_threads, n));
+        for (int k = 0; k < n; k++) pool.submit([&run, k]() { run(k); });
+        pool.wait();
+    } else {
+        for (int k = 0; k < n; k++) run(k);
+    }
+
+    if (pt.memory) {
+        long long peak = 0;
+        for (const MemoryBudget &budget : budgets) {
+            peak += budget.peak;
+            pt.memory->limit_reached |= budget.limit_reached;
+        }
+        pt.memory->use(peak);
+        pt.memory->release(peak);
+    }
+
+    for (int k = 0; k < n; k++) {
+        if (results[k] == -2) return -2;
+        if (results[k] != 0) {
+            if (pt.log)
+                *pt.log << "Component " << k << ": no solution" << std::endl;
+            return -1;
+        }
+    }
+
+    pt.solution.clear();
+    pt.solution_cost = 0;
+    pt.pending_effects.clear();
+    for (int k = 0; k < n; k++) {
+        if (pt.log)
+            *pt.log << "Component " << k << ": " << components[k].goals.size()
+                    << " goals, " << components[k].vars.size() << " vars, "
+                    << components[k].actions.size() << " actions, cost "
+                    << subs[k].solution_cost << std::endl;
+        pt.solution.insert(pt.solution.end(), subs[k].solution.begin(),
+                           subs[k].solution.end());
+        pt.solution_cost += subs[k].solution_cost;
+    }
+    pt.is_used.assign(pt.core->n_actions, false);
+    pt.used_key = 0;
+    for (int idx : pt.solution) pt.mark_used(idx);
+
+    PlanValidator validator(*pt.core);
+    if (validator.validate(pt.initial_state, pt.goal_state, pt.solution,
+                           pt.solution_cost))
+        return 0;
+    if (pt.log)
+        *pt.log << "Concatenated plan not valid (step "
+                << validator.failed_step << ": " << validator.error
+                << "), solving the whole task" << std::endl;
+    pt.solution.clear();
+    pt.solution_cost = 0;
+    pt.is_used.assign(pt.core->n_actions, false);
+    pt.used_key = 0;
+    return solve_whole();
+}
@@ -0,0 +1,69 @@
+#include "../include/heuristic_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+const int HeuristicCache::bucket_size;
+
+HeuristicCache::HeuristicCache(long long bytes, Policy policy)
+    : entries(std::max<long long>(bytes / sizeof(Entry) / bucket_size, 1) *
+              bucket_size) {
+    this->policy = policy;
+}
+
+uint64_t HeuristicCache::first_slot(uint64_t key) const {
+    uint64_t n_buckets = this->entries.size() / n_slots();
+    return key % n_buckets * n_slots();
+}
+
+bool HeuristicCache::find(uint64_t key, int &value) {
+    uint64_t first = first_slot(key);
+    for (int i = 0; i < n_slots(); i++) {
+        Entry &entry = this->entries[first + i];
+        uint64_t data = entry.data.load(std::memory_order_relaxed);
+        if ((entry.check.load(std::memory_order_relaxed) ^ data) != key ||
+            data == 0)
+            continue;
+        value = (int32_t)(uint32_t)data;
+        if (this->policy == lru) {
+            uint32_t now =
+                this->clock.fetch_add(1, std::memory_order_relaxed);
+            data = ((uint64_t)(now | 1) << 32) | (uint32_t)data;
+            entry.data.store(data, std::memory_order_relaxed);
+            entry.check.store(key ^ data, std::memory_order_relaxed);
+        }
+        this->n_hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    this->n_misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void HeuristicCache::store(uint64_t key, int value) {
+    uint64_t first = first_slot(key);
+    int victim = 0;
+    uint32_t now = this->clock.fetch_add(1, std::memory_order_relaxed);
+    uint32_t oldest_age = 0;
+    for (int i = 0; i < n_slots(); i++) {
+        Entry &entry = this->entries[first + i];
+        uint64_t data = entry.data.load(std::memory_order_relaxed);
+        if (data == 0 ||
+            (entry.check.load(std::memory_order_relaxed) ^ data) == key) {
+            victim = i;  // empty or the same key
+            break;
+        }
+        uint32_t age = now - (uint32_t)(data >> 32);
+        if (age >= oldest_age) {
+            oldest_age = age;
+            victim = i;
+        }
+    }
+    // the stamp keeps data != 0, which marks an empty entry
+    uint64_t data = ((uint64_t)(now | 1) << 32) | (uint32_t)value;
+    Entry &entry = this->entries[first + victim];
+    entry.data.store(data, std::memory_order_relaxed);
+    entry.check.store(key ^ data, std::memory_order_relaxed);
+    this->n_stores.fetch_add(1, std::memory_order_relaxed);
+}
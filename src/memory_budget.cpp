@@ -0,0 +1,27 @@
+#include "../include/memory_budget.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+
+bool MemoryBudget::charge(long long bytes) {
+    if (this->limit && this->used + bytes > this->limit) {
+        this->limit_reached = true;
+        return false;
+    }
+    use(bytes);
+    return true;
+}
+
+void MemoryBudget::use(long long bytes) {
+    this->used += bytes;
+    this->peak = std::max(this->peak, this->used);
+}
+
+void MemoryBudget::release(long long bytes) { this->used -= bytes; }
+
+long long MemoryBudget::peak_resident() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (long long)usage.ru_maxrss * 1024;  // kilobytes on Linux
+}
@@ -0,0 +1,142 @@
+#include "../include/plan_validator.h"
+
+#include <string>
+#include <vector>
+
+PlanValidator::PlanValidator(const TaskCore &core) {
+    this->core = &core;
+    this->layer_axioms.resize(core.max_axiom_layer + 1);
+    for (int i = 0; i < core.n_axioms; i++) {
+        int layer = core.vars[core.axioms[i].affected_var].axiom_layer;
+        if (layer >= 0 && layer <= core.max_axiom_layer)
+            this->layer_axioms[layer].push_back(i);
+    }
+}
+
+void PlanValidator::add(int fact) {
+    if (this->state.has(fact)) return;
+    this->state.add(fact);
+    for (int m : this->core->fact_mutexes[fact]) this->mutex_n_true[m]++;
+}
+
+// same test as PlanningTask::check_mutex_groups
+bool PlanValidator::blocked(int fact) {
+    for (int m : this->core->fact_mutexes[fact])
+        if (this->mutex_n_true[m]) return true;
+    return false;
+}
+
+bool PlanValidator::holds(int fact) {
+    return fact == -1 || this->state.has(fact);
+}
+
+/*
+    apply the effect if its conditions and from value hold and no mutex group
+    blocks it
+*/
+bool PlanValidator::try_effect(int e) {
+    const OperatorTable &ops = this->core->ops;
+    if (!ops.conds_hold(e, this->state)) return false;
+    if (!holds(ops.effect_from[e]) || blocked(ops.effect_to[e])) return false;
+    add(ops.effect_to[e]);
+    return true;
+}
+
+void PlanValidator::apply_axioms() {
+    for (const std::vector<int> &axioms : this->layer_axioms) {
+        for (int i : axioms) {
+            const Axiom &axiom = this->core->axioms[i];
+            int j;
+            for (j = 0; j < axiom.n_conds; j++)
+                if (!this->state.has(axiom.cond_ids[j])) break;
+            if (j == axiom.n_conds && holds(axiom.from_id) &&
+                !blocked(axiom.to_id))
+                add(axiom.to_id);
+        }
+    }
+}
+
+// newest first, as PlanningTask::apply_pending_effects
+int PlanValidator::apply_pending_effects() {
+    int n_applied = 0;
+    for (int i = this->pending.size() - 1; i >= 0; i--) {
+        if (try_effect(this->pending[i])) {
+            this->pending.erase(this->pending.begin() + i);
+            n_applied++;
+        }
+    }
+    return n_applied;
+}
+
+std::string PlanValidator::fact_name(int fact) {
+    const Fact &f = this->core->facts[fact];
+    const Variable &var = this->core->vars[f.var_idx];
+    std::string name = var.name + " = " + std::to_string(f.var_val);
+    if (f.var_val < var.sym_names.size())
+        name += " (" + var.sym_names[f.var_val] + ")";
+    return name;
+}
+
+bool PlanValidator::fail(int step, const std::string &reason) {
+    this->valid = false;
+    this->failed_step = step;
+    this->error = reason;
+    return false;
+}
+
+bool PlanValidator::validate(const std::vector<int> &initial_state,
+                             const std::vector<Fact> &goal_state,
+                             const std::vector<int> &plan,
+                             int expected_cost) {
+    const TaskCore &core = *this->core;
+    this->valid = true;
+    this->failed_step = -1;
+    this->error.clear();
+    this->cost = 0;
+    this->state = State(core.n_facts);
+    this->mutex_n_true.assign(core.n_mutex, 0);
+    this->pending.clear();
+    for (int var = 0; var < initial_state.size(); var++)
+        add(core.fact_id(var, initial_state[var]));
+
+    for (int k = 0; k < plan.size(); k++) {
+        int idx = plan[k];
+        if (idx < 0 || idx >= core.n_actions)
+            return fail(k, "action " + std::to_string(idx) + " out of range");
+        const OperatorTable &ops = core.ops;
+
+        apply_axioms();
+        apply_pending_effects();
+
+        for (int j = ops.precond_start[idx]; j < ops.precond_start[idx + 1];
+             j++)
+            if (!this->state.has(ops.precond_ids[j]))
+                return fail(k, core.action_name(idx) + ": precondition " +
+                                   fact_name(ops.precond_ids[j]) +
+                                   " does not hold");
+        for (int e = ops.effect_start[idx]; e < ops.effect_start[idx + 1]; e++)
+            if (!try_effect(e)) this->pending.push_back(e);
+        this->cost += core.metric == 1 ? ops.cost[idx] : 1;
+    }
+
+    // as in solve, axioms and pending effects may still reach the goal
+    int k = plan.size();
+    auto goal_fact = [&]() {
+        for (const Fact &goal : goal_state)
+            if (!this->state.has(core.fact_id(goal))) return core.fact_id(goal);
+        return -1;
+    };
+    while (goal_fact() != -1) {
+        State before = this->state;
+        apply_axioms();
+        apply_pending_effects();
+        if (this->state.words == before.words) break;
+    }
+    if (goal_fact() != -1)
+        return fail(k, "goal " + fact_name(goal_fact()) + " not reached");
+    if (expected_cost != -1 && expected_cost != this->cost)
+        return fail(k, "cost " + std::to_string(this->cost) +
+                           " differs from the reported cost " +
+                           std::to_string(expected_cost));
+    return true;
+}
@@ -0,0 +1,145 @@
+#include "../include/planner.h"
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../include/decomposition.h"
+#include "../include/memory_budget.h"
+#include "../include/planning_task_parser.h"
+#include "../include/subproblem.h"
+
+const Algorithm algorithms[] = {
+    {"random", "random"},
+    {"greedy", "greedy"},
+    {"greedy + pruning", "greedy + pruning"},
+    {"h_max + lookahead", "hmax + lookahead"},
+    {"backward cost propagation (min)", "backward cost propagation (min)"},
+    {"backward cost propagation (max)", "backward cost propagation (max)"},
+    {"backward cost propagation (sum)", "backward cost propagation (sum)"},
+    {"re-apply alg 4", "reapply backward cost propagation (min)"},
+    {"alg 4 + ucs", "backward cost propagation (min) + ucs"},
+    {"relaxed plan extraction", "relaxed plan extraction"},
+    {"alg 4 + branch and bound", "backward cost propagation (min) + branch "
+                                 "and bound"},
+};
+const int n_algorithms = sizeof(algorithms) / sizeof(algorithms[0]);
+
+void Planner::load(std::istream &file, int preprocess, bool reorder) {
+    PlanningTaskParser parser;
+    parser.preprocessor.remove_dominated = preprocess >= 2;
+    parser.reorder = reorder;
+    this->task = parser.parse(file, preprocess);
+    this->preprocessor = parser.preprocessor;
+}
+
+void Planner::load_file(const std::string &file_name, int preprocess,
+                        bool reorder) {
+    std::ifstream file(file_name);
+    if (!file.is_open()) throw std::runtime_error("Failed to open the file");
+    load(file, preprocess, reorder);
+}
+
+void Planner::load_string(const std::string &sas, int preprocess,
+                          bool reorder) {
+    std::istringstream file(sas);
+    load(file, preprocess, reorder);
+}
+
+// plan of pt in input file indices
+static void original_plan(const PlanningTask &pt, PlannerResult &result) {
+    result.plan.clear();
+    result.action_names.clear();
+    for (int idx : pt.solution) {
+        const Action &action = pt.core->actions[idx];
+        result.plan.push_back(action.original_idx);
+        result.action_names.push_back(pt.core->action_name(idx));
+    }
+    result.cost = pt.solution_cost;
+}
+
+void Planner::enable_heuristic_cache(long long bytes,
+                                     HeuristicCache::Policy policy) {
+    this->heuristic_cache = std::make_shared<HeuristicCache>(bytes, policy);
+}
+
+PlannerResult Planner::solve(const PlannerOptions &options) const {
+    if (options.alg < 0 || options.alg >= n_algorithms)
+        throw std::invalid_argument("Unknown alg code " +
+                                    std::to_string(options.alg));
+    bool reoptimise = options.alg == 7 || options.alg == 8;
+    bool adaptive = options.start == -1 && options.end == 2;
+    if (reoptimise && !adaptive &&
+        (options.start < 0 || options.end > 1 || options.start >= options.end))
+        throw std::invalid_argument("For alg 7 and 8: 0 <= start < end <= 1");
+    if (options.restarts < 1)
+        throw std::invalid_argument("restarts must be at least 1");
+    if (options.decompose < 0)
+        throw std::invalid_argument("decompose must not be negative");
+
+    std::chrono::steady_clock::time_point begin =
+        std::chrono::steady_clock::now();
+    MemoryBudget memory;
+    memory.limit = options.memory_limit;
+
+    // a search of its own on the shared core
+    PlanningTask pt(this->task);
+    pt.initial_state = this->task.initial_state;
+    pt.goal_state = this->task.goal_state;
+    pt.n_goals = this->task.n_goals;
+    pt.memory = &memory;
+    pt.heuristic_cache = this->heuristic_cache.get();
+    pt.log = options.log;
+    if (options.time_limit >= 0) pt.set_time_limit(options.time_limit);
+
+    int heuristic = reoptimise || options.alg == 10 ? 4 : options.alg;
+    int res;
+    if (options.decompose > 0)
+        res = solve_decomposed(pt, options.seed, heuristic, options.debug,
+                               options.restarts, options.decompose);
+    else if (options.restarts > 1)
+        res = pt.solve_restarts(options.seed, heuristic, options.debug,
+                                options.restarts);
+    else
+        res = pt.solve(options.seed, heuristic, options.debug);
+    if (options.alg == 10 && res != -2) res = pt.branch_and_bound(res == 0);
+    bool has_plan = res == 0;
+    if (has_plan && reoptimise) {
+        std::function<void()> on_improved;
+        if (options.on_incumbent) {
+            on_improved = [&]() {
+                PlannerResult incumbent;
+                original_plan(pt, incumbent);
+                options.on_incumbent(incumbent.plan, incumbent.cost);
+            };
+            on_improved();
+        }
+        PlanningTask sub;
+        res = adaptive
+                  ? reoptimise_windows(pt, sub, options.alg, options.seed,
+                                       options.debug, on_improved)
+                  : reoptimise_window(pt, sub, options.alg, options.seed,
+                                      options.debug, options.start,
+                                      options.end, on_improved);
+        if (res == 1) res = 0;  // empty window: the plan of alg 4
+    }
+
+    PlannerResult result;
+    result.cost = -1;
+    result.lower_bound = -1;
+    if (has_plan) original_plan(pt, result);
+    if (has_plan && options.alg == 10) result.lower_bound = pt.proven_bound;
+    result.status = res == 0    ? PlannerResult::solved
+                    : res == -2 ? PlannerResult::time_limit
+                                : PlannerResult::no_solution;
+    result.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - begin)
+                         .count();
+    result.peak_memory = memory.peak;
+    result.memory_limit_reached = memory.limit_reached;
+    return result;
+}
@@ -1,8 +1,5 @@
 #include "../include/planning_task.h"
 
-#include <signal.h>
-#include <unistd.h>
-
 #include <algorithm>
 #include <cassert>
 #include <cstdlib>
@@ -19,10 +16,30 @@
 #include <unordered_set>
 #include <vector>
 
+#include "../include/heuristic_cache.h"
+#include "../include/memory_budget.h"
+#include "../include/plan_validator.h"
 #include "../include/planning_task_utils.h"
 #include "../include/pq.h"
+#include "../include/rpg.h"
+
+const int PlanningTask::ucs_max_states;
+
+TaskCore::TaskCore(int metric, int n_vars, std::vector<Variable> &vars,
+                   int n_mutex, std::vector<MutexGroup> &mutexes,
+                   int n_actions, std::vector<Action> &actions, int n_axioms,
+                   std::vector<Axiom> &axioms) {
+    this->metric = metric;
+    this->n_vars = n_vars;
+    this->vars = vars, this->n_mutex = n_mutex;
+    this->mutexes = mutexes;
+    this->n_actions = n_actions;
+    this->actions = actions;
+    this->n_axioms = n_axioms;
+    this->axioms = axioms;
 
-#define FIND_FACT_INDEX(f) (this->fact_to_index[f])
+    create_structs();
+}
 
 PlanningTask::PlanningTask(int metric, int n_vars, std::vector<Variable> &vars,
                            int n_mutex, std::vector<MutexGroup> &mutexes,
@@ -30,46 +47,113 @@ PlanningTask::PlanningTask(int metric, int n_vars, std::vector<Variable> &vars,
                            std::vector<Fact> &goal_state, int n_actions,
                            std::vector<Action> &actions, int n_axioms,
                            std::vector<Axiom> &axioms) {
-    this->metric = metric;
-    this->n_vars = n_vars;
-    this->vars = vars, this->n_mutex = n_mutex;
-    this->mutexes = mutexes;
+    this->core = std::make_shared<const TaskCore>(
+        metric, n_vars, vars, n_mutex, mutexes, n_actions, actions, n_axioms,
+        axioms);
     this->initial_state = initial_state;
     this->n_goals = n_goals;
     this->goal_state = goal_state;
-    this->n_actions = n_actions;
-    this->actions = actions;
-    this->n_axioms = n_axioms;
-    this->axioms = axioms;
 
+    this->is_used.assign(n_actions, false);
+    this->h_cost.assign(n_actions, std::numeric_limits<int>::max());
     this->solution_cost = 0;
 }
 
 PlanningTask::PlanningTask(const PlanningTask &other) {
-    this->metric = other.metric;
-    this->n_vars = other.n_vars;
-    this->vars = other.vars, this->n_mutex = other.n_mutex;
-    this->mutexes = other.mutexes;
-    this->n_actions = other.n_actions;
-    this->actions = other.actions;
-    reset_actions_metadata();
-    for (int i = 0; i < this->n_actions; i++) {
-        this->actions[i].is_used = false;
-    }
-    this->n_axioms = other.n_axioms;
-    this->axioms = other.axioms;
-
+    this->core = other.core;
+    this->memory = other.memory;
+    this->heuristic_cache = other.heuristic_cache;
+    this->log = other.log;
+    this->has_deadline = other.has_deadline;
+    this->deadline = other.deadline;
+    this->n_goals = 0;
+    this->is_used.assign(this->core->n_actions, false);
+    this->h_cost.assign(this->core->n_actions,
+                        std::numeric_limits<int>::max());
     this->solution_cost = 0;
 }
 
+PlanningTask &PlanningTask::operator=(const PlanningTask &other) {
+    if (this == &other) return *this;
+    this->core = other.core;
+    this->initial_state = other.initial_state;
+    this->n_goals = other.n_goals;
+    this->goal_state = other.goal_state;
+    this->is_used = other.is_used;
+    this->used_key = other.used_key;
+    this->state_key = other.state_key;
+    this->h_cost = other.h_cost;
+    this->solution = other.solution;
+    this->solution_cost = other.solution_cost;
+    this->proven_bound = other.proven_bound;
+    this->pending_effects = other.pending_effects;
+    // rebuilt on first use, so that no two tasks share them
+    this->rpg.reset();
+    this->scratch.reset();
+    this->memory = other.memory;
+    this->heuristic_cache = other.heuristic_cache;
+    this->log = other.log;
+    this->has_deadline = other.has_deadline;
+    this->deadline = other.deadline;
+    this->rng = other.rng;
+    this->cost_bound = other.cost_bound;
+    return *this;
+}
+
+bool PlanningTask::charge_memory(long long bytes) {
+    return !this->memory || this->memory->charge(bytes);
+}
+
+void PlanningTask::use_memory(long long bytes) {
+    if (this->memory) this->memory->use(bytes);
+}
+
+void PlanningTask::release_memory(long long bytes) {
+    if (this->memory) this->memory->release(bytes);
+}
+
+/*
+    key of the h_max value, with no action used, of a state whose facts have
+    the key facts_key: h_max also depends on the goals. The key of the goals
+    is mixed, otherwise moving a fact between the state and the goals would
+    keep the XOR
+*/
+uint64_t PlanningTask::bound_key(uint64_t facts_key) {
+    uint64_t goals = 0;
+    for (int i = 0; i < this->n_goals; i++)
+        goals ^=
+            this->core->fact_keys[this->core->fact_id(this->goal_state[i])];
+    goals = (goals ^ (goals >> 30)) * 0xbf58476d1ce4e5b9ull;
+    goals = (goals ^ (goals >> 27)) * 0x94d049bb133111ebull;
+    return facts_key ^ goals ^ (goals >> 31);
+}
+
+/*
+    key of the h_max value of a state, which skips the used actions. With no
+    action used it is the bound_key, and the values are the same
+*/
+uint64_t PlanningTask::heuristic_key(uint64_t facts_key) {
+    return bound_key(facts_key) ^ this->used_key;
+}
+
+void PlanningTask::mark_used(int idx) {
+    if (this->is_used[idx]) return;
+    this->is_used[idx] = true;
+    this->used_key ^= this->core->action_keys[idx];
+}
+
+void PlanningTask::reset_used_key() {
+    this->used_key = 0;
+    for (int i = 0; i < this->core->n_actions; i++)
+        if (this->is_used[i]) this->used_key ^= this->core->action_keys[i];
+}
+
 /*
     check if the current state is a goal state
 */
-bool PlanningTask::goal_reached(
-    std::vector<std::unordered_set<int>> &current_state) {
+bool PlanningTask::goal_reached(State &current_state) {
     for (int i = 0; i < this->n_goals; i++) {
-        int idx = this->goal_state[i].var_idx;
-        if (!current_state[idx].count(this->goal_state[i].var_val))
+        if (!current_state.has(this->core->fact_id(this->goal_state[i])))
             return false;
     }
     return true;
@@ -80,240 +164,285 @@ bool PlanningTask::goal_reached(
     in each mutex at most one fact can be true
 
     if a mutex already have a true fact, then we cannot apply any update to that
-   mutex
+   mutex (only the mutexes containing the updated fact need to be checked)
 */
-bool PlanningTask::check_mutex_groups(
-    int var_to_update, int new_value,
-    std::vector<std::unordered_set<int>> &current_state) {
-    for (int i = 0; i < this->n_mutex; i++) {
-        MutexGroup mutex = this->mutexes[i];
-        bool mutex_fact_in_solution = false;
-        bool update_in_mutex = false;
-        for (int j = 0; j < mutex.n_facts; j++) {
-            int fact_var = mutex.facts[j].var_idx;
-            int fact_value = mutex.facts[j].var_val;
-            if (current_state[fact_var].count(fact_value))
-                mutex_fact_in_solution = true;
-            if (fact_var == var_to_update && fact_value == new_value)
-                update_in_mutex = true;
-        }
-        if (mutex_fact_in_solution && update_in_mutex) return false;
+bool PlanningTask::check_mutex_groups(int fact, State &current_state) {
+    for (int m : this->core->fact_mutexes[fact]) {
+        const MutexGroup &mutex = this->core->mutexes[m];
+        for (int j = 0; j < mutex.n_facts; j++)
+            if (current_state.has(mutex.fact_ids[j])) return false;
     }
     return true;
 }
 
-int PlanningTask::get_max_axiom_layer() {
-    int max = -1;
-    for (int i = 0; i < this->n_vars; i++)
-        if (this->vars[i].axiom_layer > max) max = this->vars[i].axiom_layer;
-    return max;
-}
-
-bool PlanningTask::check_axiom_cond(
-    Axiom axiom, std::vector<std::unordered_set<int>> &current_state) {
+bool PlanningTask::check_axiom_cond(const Axiom &axiom,
+                                    State &current_state) {
     for (int i = 0; i < axiom.n_conds; i++) {
-        if (!current_state[axiom.conds[i].var_idx].count(
-                axiom.conds[i].var_val))
-            return false;
+        if (!current_state.has(axiom.cond_ids[i])) return false;
     }
     return true;
 }
 
-void PlanningTask::apply_axioms(
-    std::vector<std::unordered_set<int>> &current_state) {
-    int max_axiom_layer = get_max_axiom_layer();
-    for (int axiom_layer = 0; axiom_layer <= max_axiom_layer; axiom_layer++) {
-        for (int i = 0; i < this->n_axioms; i++) {
-            Axiom axiom = this->axioms[i];
-            if (this->vars[axiom.affected_var].axiom_layer == axiom_layer &&
+void PlanningTask::apply_axioms(State &current_state, uint64_t *key) {
+    for (int axiom_layer = 0; axiom_layer <= this->core->max_axiom_layer;
+         axiom_layer++) {
+        for (int i = 0; i < this->core->n_axioms; i++) {
+            const Axiom &axiom = this->core->axioms[i];
+            if (this->core->vars[axiom.affected_var].axiom_layer ==
+                    axiom_layer &&
                 check_axiom_cond(axiom, current_state)) {
-                if ((current_state[axiom.affected_var].count(
-                         axiom.from_value) ||
-                     axiom.from_value == -1) &&
-                    check_mutex_groups(axiom.affected_var, axiom.to_value,
-                                       current_state)) {
-                    current_state[axiom.affected_var].insert(axiom.to_value);
+                if ((axiom.from_id == -1 ||
+                     current_state.has(axiom.from_id)) &&
+                    check_mutex_groups(axiom.to_id, current_state)) {
+                    if (key && !current_state.has(axiom.to_id))
+                        *key ^= this->core->fact_keys[axiom.to_id];
+                    current_state.add(axiom.to_id);
                 }
             }
         }
     }
 }
 
-std::vector<int> PlanningTask::get_possible_actions_idx(
-    std::vector<std::unordered_set<int>> &current_state, bool check_usage) {
-    std::vector<int> actions_idx;
-    for (int i = 0; i < this->n_actions; i++) {
-        Action action = this->actions[i];
-        if (check_usage && action.is_used)
+SearchScratch &PlanningTask::get_scratch() {
+    if (!this->scratch)
+        this->scratch = std::make_shared<SearchScratch>(this->core->n_facts);
+    return *this->scratch;
+}
+
+void PlanningTask::get_possible_actions_idx(State &current_state,
+                                            bool check_usage,
+                                            std::vector<int> &actions_idx) {
+    actions_idx.clear();
+    const OperatorTable &ops = this->core->ops;
+    for (int i = 0; i < this->core->n_actions; i++) {
+        if (check_usage && this->is_used[i])
             continue;  // skip actions already used
         int j;
-        for (j = 0; j < action.n_preconds; j++)
-            if (!current_state[action.preconds[j].var_idx].count(
-                    action.preconds[j].var_val))
-                break;
-        if (j == action.n_preconds) {
+        for (j = ops.precond_start[i]; j < ops.precond_start[i + 1]; j++)
+            if (!current_state.has(ops.precond_ids[j])) break;
+        if (j == ops.precond_start[i + 1]) {
             actions_idx.push_back(i);
         }
     }
-    std::stable_sort(
-        actions_idx.begin(), actions_idx.end(), [this](int idx_a, int idx_b) {
-            return this->actions[idx_a].h_cost < this->actions[idx_b].h_cost;
-        });
-    return actions_idx;
+    // ties by index: the order of a stable sort, without its buffer
+    std::sort(actions_idx.begin(), actions_idx.end(),
+              [this](int idx_a, int idx_b) {
+                  if (this->h_cost[idx_a] != this->h_cost[idx_b])
+                      return this->h_cost[idx_a] < this->h_cost[idx_b];
+                  return idx_a < idx_b;
+              });
 }
 
-int PlanningTask::compute_next_state(
-    int idx, std::vector<std::unordered_set<int>> &current_state) {
+int PlanningTask::compute_next_state(int idx, State &current_state,
+                                     uint64_t *key) {
     int n_applied_effects = 0;  // count applied effects during this iteration
-    for (int i = 0; i < this->actions[idx].n_effects; i++) {
-        Effect effect = this->actions[idx].effects[i];
-        int j;
-        for (j = 0; j < effect.n_effect_conds; j++) {
-            Fact effect_cond = effect.effect_conds[j];
-            if (!current_state[effect_cond.var_idx].count(
-                    effect_cond.var_val) &&
-                effect_cond.var_val != -1)
-                break;
-        }
-        if (j < effect.n_effect_conds) {  // the effect cannot be applied
-            this->pending_effects.push_back(effect);
+    const OperatorTable &ops = this->core->ops;
+    for (int e = ops.effect_start[idx]; e < ops.effect_start[idx + 1]; e++) {
+        if (!ops.conds_hold(e, current_state)) {
+            // the effect cannot be applied
+            this->pending_effects.push_back(e);
             continue;
         }
-        int var = effect.var_affected;
-        if ((current_state[var].count(effect.from_value) ||
-             effect.from_value == -1) &&
-            check_mutex_groups(var, effect.to_value, current_state)) {
-            current_state[var].insert(effect.to_value);
+        int from = ops.effect_from[e], to = ops.effect_to[e];
+        if ((from == -1 || current_state.has(from)) &&
+            check_mutex_groups(to, current_state)) {
+            if (key && !current_state.has(to))
+                *key ^= this->core->fact_keys[to];
+            current_state.add(to);
             n_applied_effects++;
         } else {
-            this->pending_effects.push_back(effect);
+            this->pending_effects.push_back(e);
         }
     }
     return n_applied_effects;
 }
 
-int PlanningTask::apply_action(
-    int idx, std::vector<std::unordered_set<int>> &current_state) {
-    int n_applied_effects = compute_next_state(idx, current_state);
+int PlanningTask::apply_action(int idx, State &current_state) {
+    int n_applied_effects =
+        compute_next_state(idx, current_state, &this->state_key);
     if (n_applied_effects) {  // at least one effect was
                               // applied
-        IndexAction indexAction;
-        indexAction.idx = idx;
-        indexAction.action = this->actions[idx];
-        this->solution.push_back(indexAction);
-        if (this->metric == 1)
-            this->solution_cost += this->actions[idx].cost;
+        this->solution.push_back(idx);
+        if (this->core->metric == 1)
+            this->solution_cost += this->core->ops.cost[idx];
         else
             this->solution_cost += 1;
-        this->actions[idx].is_used = true;
+        mark_used(idx);
     }
     return n_applied_effects;
 }
 
-void PlanningTask::print_solution() {
+void PlanningTask::print_solution(std::ostream &out) {
     for (int i = 0; i < this->solution.size(); i++) {
-        std::cout << this->solution[i].idx << ": "
-                  << this->solution[i].action.name << std::endl;
+        int idx = this->solution[i];
+        out << this->core->actions[idx].original_idx << ": "
+            << this->core->action_name(idx) << std::endl;
     }
-    std::cout << "Cost: " << this->solution_cost << std::endl;
+    out << "Cost: " << this->solution_cost << std::endl;
+}
+
+void PlanningTask::set_time_limit(double seconds) {
+    this->has_deadline = true;
+    this->deadline = std::chrono::steady_clock::now() +
+                     std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::duration<double>(seconds));
+}
+
+bool PlanningTask::deadline_passed() const {
+    return this->has_deadline &&
+           std::chrono::steady_clock::now() >= this->deadline;
 }
 
 void PlanningTask::print_action_h_costs(std::vector<int> &actions_idx) {
     std::cout << "################################## H COSTS" << std::endl;
     for (int i = 0; i < actions_idx.size(); i++) {
         int idx = actions_idx[i];
-        std::cout << this->actions[idx].h_cost << " ";
+        std::cout << this->h_cost[idx] << " ";
     }
     std::cout << std::endl;
 }
 
-void PlanningTask::create_structs() {
-    std::unordered_set<Fact, FactHasher> unique_facts;
-
-    // Add facts from INITIAL STATE
-    for (int var = 0; var < initial_state.size(); var++) {
-        Fact f{var, initial_state[var]};
-        unique_facts.insert(f);
-    }
+uint64_t TaskCore::facts_key(const State &state) const {
+    uint64_t key = 0;
+    for (int w = 0; w < state.words.size(); w++)
+        for (uint64_t bits = state.words[w]; bits; bits &= bits - 1)
+            key ^= this->fact_keys[w * 64 + __builtin_ctzll(bits)];
+    return key;
+}
 
-    // Add facts from GOALS
-    for (const Fact &goal : goal_state) {
-        unique_facts.insert(goal);
-    }
+void TaskCore::create_structs() {
+    // dense fact numbering
+    this->var_offset.assign(this->n_vars + 1, 0);
+    for (int var = 0; var < this->n_vars; var++)
+        this->var_offset[var + 1] =
+            this->var_offset[var] + this->vars[var].range;
+    this->n_facts = this->var_offset[this->n_vars];
+    this->facts.clear();
+    for (int var = 0; var < this->n_vars; var++)
+        for (int val = 0; val < this->vars[var].range; val++)
+            this->facts.push_back({var, val});
+
+    // fixed seed: the keys only depend on the task
+    Rng rng(0x9e3779b97f4a7c15ull);
+    this->fact_keys.resize(this->n_facts);
+    for (uint64_t &key : this->fact_keys) key = rng();
+    this->action_keys.resize(this->n_actions);
+    for (uint64_t &key : this->action_keys) key = rng();
+
+    this->precond_actions.assign(this->n_facts, std::vector<int>());
+    this->effect_actions.assign(this->n_facts, std::vector<int>());
+    this->fact_mutexes.assign(this->n_facts, std::vector<int>());
 
     for (int i = 0; i < this->n_actions; i++) {
         Action &action = this->actions[i];
         if (action.n_preconds == 0) this->actions_no_preconds.push_back(i);
 
-        // Add preconditions to map_fact_actions
-        for (auto &precond : action.preconds) {
-            this->map_precond_actions[precond].push_back(i);
-            unique_facts.insert(precond);
+        action.precond_ids.clear();
+        for (const Fact &precond : action.preconds) {
+            action.precond_ids.push_back(fact_id(precond));
+            this->precond_actions[action.precond_ids.back()].push_back(i);
         }
 
         // Add effects for ALL actions
-        for (const Effect &eff : action.effects) {
-            Fact f{eff.var_affected, eff.to_value};
-            this->map_effect_actions[f].push_back(i);
-            unique_facts.insert(f);
+        for (Effect &eff : action.effects) {
+            eff.cond_ids.clear();
+            for (const Fact &cond : eff.effect_conds)
+                eff.cond_ids.push_back(fact_id(cond));
+            eff.from_id = fact_id(eff.var_affected, eff.from_value);
+            eff.to_id = fact_id(eff.var_affected, eff.to_value);
+            std::vector<int> &achievers = this->effect_actions[eff.to_id];
+            if (achievers.empty() || achievers.back() != i)
+                achievers.push_back(i);
         }
     }
 
-    // add facts from axioms
-    for (int i = 0; i < this->n_axioms; i++) {
-        Fact f{this->axioms[i].affected_var, this->axioms[i].to_value};
-        unique_facts.insert(f);
+    for (Axiom &axiom : this->axioms) {
+        axiom.cond_ids.clear();
+        for (const Fact &cond : axiom.conds)
+            axiom.cond_ids.push_back(fact_id(cond));
+        axiom.from_id = fact_id(axiom.affected_var, axiom.from_value);
+        axiom.to_id = fact_id(axiom.affected_var, axiom.to_value);
     }
 
-    // Convert the set to a vector for indexing
-    this->facts.assign(unique_facts.begin(), unique_facts.end());
-
-    // Precompute fact_to_index map
-    this->fact_to_index.clear();
-    for (size_t i = 0; i < this->facts.size(); i++) {
-        this->fact_to_index[this->facts[i]] = i;
+    for (int m = 0; m < this->n_mutex; m++) {
+        MutexGroup &mutex = this->mutexes[m];
+        mutex.fact_ids.clear();
+        for (const Fact &f : mutex.facts) {
+            mutex.fact_ids.push_back(fact_id(f));
+            std::vector<int> &groups = this->fact_mutexes[fact_id(f)];
+            if (groups.empty() || groups.back() != m) groups.push_back(m);
+        }
     }
+
+    this->max_axiom_layer = -1;
+    for (int i = 0; i < this->n_vars; i++)
+        if (this->vars[i].axiom_layer > this->max_axiom_layer)
+            this->max_axiom_layer = this->vars[i].axiom_layer;
+
+    create_operator_table();
 }
 
-void PlanningTask::remove_satisfied_actions(
-    std::vector<std::unordered_set<int>> &current_state,
-    std::vector<int> &possible_actions_idx) {
-    for (int i = possible_actions_idx.size() - 1; i >= 0; i--) {
-        int idx = possible_actions_idx[i];
-        std::vector<Effect> effects = this->actions[idx].effects;
-        int count = 0;
-        for (int j = 0; j < effects.size(); j++) {
-            if (current_state[effects[j].var_affected].count(
-                    effects[j].to_value))
-                count++;
-        }
-        if (count == effects.size()) {
-            possible_actions_idx.erase(possible_actions_idx.begin() + i);
-            this->actions[idx].is_used =
-                true;  // this action shouldn't be returned anymore
+void TaskCore::create_operator_table() {
+    OperatorTable &ops = this->ops;
+    ops = OperatorTable();
+    ops.precond_start.push_back(0);
+    ops.effect_start.push_back(0);
+    ops.cond_start.push_back(0);
+    this->names.clear();
+    this->name_start.assign(1, 0);
+    for (int i = 0; i < this->n_actions; i++) {
+        Action &action = this->actions[i];
+        ops.cost.push_back(action.cost);
+        ops.precond_ids.insert(ops.precond_ids.end(),
+                               action.precond_ids.begin(),
+                               action.precond_ids.end());
+        ops.precond_start.push_back(ops.precond_ids.size());
+        for (const Effect &eff : action.effects) {
+            ops.effect_action.push_back(i);
+            ops.effect_from.push_back(eff.from_id);
+            ops.effect_to.push_back(eff.to_id);
+            for (int cond : eff.cond_ids)
+                if (cond != -1) ops.cond_ids.push_back(cond);
+            ops.unconditional.push_back(ops.cond_ids.size() ==
+                                        ops.cond_start.back());
+            ops.cond_start.push_back(ops.cond_ids.size());
         }
+        ops.effect_start.push_back(ops.effect_action.size());
+
+        this->names += action.name;
+        this->name_start.push_back(this->names.size());
+        std::string().swap(action.name);
     }
 }
 
-int PlanningTask::h_max(std::vector<std::unordered_set<int>> &current_state,
-                        Fact &fact, std::unordered_set<int> &visited,
-                        std::unordered_map<int, int> &cache) {
-    int fact_idx = FIND_FACT_INDEX(fact);
+void PlanningTask::remove_satisfied_actions(
+    State &current_state, std::vector<int> &possible_actions_idx) {
+    const OperatorTable &ops = this->core->ops;
+    int n_kept = 0;
+    for (int idx : possible_actions_idx) {
+        int e;
+        for (e = ops.effect_start[idx]; e < ops.effect_start[idx + 1]; e++)
+            if (!current_state.has(ops.effect_to[e])) break;
+        if (e == ops.effect_start[idx + 1])
+            mark_used(idx);  // this action shouldn't be returned anymore
+        else
+            possible_actions_idx[n_kept++] = idx;
+    }
+    possible_actions_idx.resize(n_kept);
+}
 
+int PlanningTask::h_max(State &current_state, int fact,
+                        std::vector<char> &visited, std::vector<int> &cache,
+                        std::vector<char> &cached) {
     // **Check Cache**
-    if (cache.find(fact_idx) != cache.end()) {
-        return cache[fact_idx];  // Return stored result
-    }
+    if (cached[fact]) return cache[fact];  // Return stored result
 
-    if (current_state[fact.var_idx].count(fact.var_val) ||
-        visited.find(fact_idx) != visited.end()) {
-        return 0;  // Base case
-    }
+    if (current_state.has(fact) || visited[fact]) return 0;  // Base case
 
-    visited.insert(fact_idx);
+    visited[fact] = 1;
 
     // Get all the actions having "fact" as outcome
-    std::vector<int> actions_idx = this->map_effect_actions[fact];
+    const std::vector<int> &actions_idx = this->core->effect_actions[fact];
 
     if (actions_idx.empty())  // The fact is unreachable
         return std::numeric_limits<int>::max();
@@ -321,59 +450,269 @@ int PlanningTask::h_max(std::vector<std::unordered_set<int>> &current_state,
     int min_h_cost = std::numeric_limits<int>::max();
 
     for (int idx : actions_idx) {
-        if (this->actions[idx].is_used) continue;
-        if (this->metric == 1)
-            this->actions[idx].h_cost = this->actions[idx].cost;
+        if (this->is_used[idx]) continue;
+        const OperatorTable &ops = this->core->ops;
+        if (this->core->metric == 1)
+            this->h_cost[idx] = ops.cost[idx];
         else
-            this->actions[idx].h_cost = 1;
+            this->h_cost[idx] = 1;
 
         int max_cost = 0;
-        for (int j = 0; j < this->actions[idx].n_preconds; j++) {
-            max_cost = std::max(
-                max_cost, h_max(current_state, this->actions[idx].preconds[j],
-                                visited, cache));
+        for (int j = ops.precond_start[idx]; j < ops.precond_start[idx + 1];
+             j++) {
+            max_cost = std::max(max_cost, h_max(current_state,
+                                                ops.precond_ids[j], visited,
+                                                cache, cached));
         }
 
-        this->actions[idx].h_cost += max_cost;
-        min_h_cost = std::min(min_h_cost, this->actions[idx].h_cost);
+        if (max_cost == std::numeric_limits<int>::max())
+            this->h_cost[idx] = max_cost;  // a precondition is unreachable
+        else
+            this->h_cost[idx] += max_cost;
+        min_h_cost = std::min(min_h_cost, this->h_cost[idx]);
     }
 
     // **Store Computed Result in Cache**
-    cache[fact_idx] = min_h_cost;
+    cache[fact] = min_h_cost;
+    cached[fact] = 1;
     return min_h_cost;
 }
 
 void PlanningTask::reset_actions_metadata() {
-    for (int i = 0; i < this->n_actions; i++) {
-        this->actions[i].h_cost = std::numeric_limits<int>::max();
+    for (int i = 0; i < this->core->n_actions; i++) {
+        this->h_cost[i] = std::numeric_limits<int>::max();
     }
 }
 
-int PlanningTask::compute_heuristic(
-    std::vector<std::unordered_set<int>> &current_state, int heuristic) {
+/*
+    h_max of algs 2 and 3 with unit costs, exact also on cyclic tasks: the
+    recursive h_max it replaces (still used with action costs) cuts a cycle
+    at 0 and caches the values computed with the cut, so plans differ from
+    the ones of that version. Only the actions reached going backwards from
+    the goals get a cost, 1 + the level where they apply. The graph stops at
+    the goal layer, which leaves out only actions that are not applicable
+    now, so the ranking of applicable actions is exact
+*/
+int PlanningTask::rpg_heuristic(State &current_state) {
+    if (!this->rpg)
+        this->rpg = std::make_shared<RelaxedPlanningGraph>(*this->core);
+    SearchScratch &scratch = get_scratch();
+    std::vector<int> &goals = scratch.goals;
+    goals.clear();
+    for (int i = 0; i < this->n_goals; i++)
+        goals.push_back(this->core->fact_id(this->goal_state[i]));
+    this->rpg->build(current_state, this->is_used, goals);
+    const std::vector<int> &fact_level = this->rpg->fact_level;
+    const std::vector<int> &action_level = this->rpg->action_level;
+
     int total = 0;
-    std::unordered_map<int, int> cache;  // Cache to store heuristic values
+    for (int goal : goals) {
+        if (fact_level[goal] == RelaxedPlanningGraph::unreachable) {
+            total = std::numeric_limits<int>::max();
+            break;
+        }
+        total = std::max(total, fact_level[goal]);
+    }
+
+    std::vector<int> &cone = scratch.cone;
+    this->rpg->backward_cone(current_state, this->is_used, goals, cone);
+    for (int idx : cone)
+        if (action_level[idx] != RelaxedPlanningGraph::unreachable)
+            this->h_cost[idx] = 1 + action_level[idx];
+    return total;
+}
+
+/*
+    exact h_max of the goals with action costs, for lower_bound: a Dijkstra
+    on the facts from current_state, where an action is reached, at the cost
+    of its costliest precondition, once all its preconditions are popped.
+    The facts of the state never enter the queue, and the search stops when
+    the last goal is popped. No h_cost is set: algs 2 and 3 keep the
+    recursive h_max, which costs less per state
+*/
+int PlanningTask::weighted_h_max(State &current_state) {
+    const TaskCore &core = *this->core;
+    const OperatorTable &ops = core.ops;
+    const int inf = std::numeric_limits<int>::max();
+    long long bytes = (2 * core.n_facts + core.n_actions) * sizeof(int);
+    use_memory(bytes);
+    SearchScratch &scratch = get_scratch();
+    PriorityQueue<int> &pq = scratch.fact_queue;
+    std::vector<int> &fact_costs = scratch.fact_costs;
+    std::vector<int> &missing = scratch.missing;
+    std::vector<char> &is_goal = scratch.is_goal;
+    fact_costs.assign(core.n_facts, inf);
+    missing.resize(core.n_actions);
+    is_goal.resize(core.n_facts, 0);
+
+    std::vector<int> &goals = scratch.goals;
+    goals.clear();
+    int n_open = 0;  // goals not popped yet
+    for (int i = 0; i < this->n_goals; i++) {
+        int goal = core.fact_id(this->goal_state[i]);
+        if (current_state.has(goal) || is_goal[goal]) continue;
+        is_goal[goal] = 1;
+        goals.push_back(goal);
+        n_open++;
+    }
+
+    auto reach = [&](int action, int cost) {
+        cost += ops.cost[action];
+        for (int e = ops.effect_start[action]; e < ops.effect_start[action + 1];
+             e++) {
+            int to = ops.effect_to[e];
+            if (cost >= fact_costs[to]) continue;
+            fact_costs[to] = cost;
+            // not pq.change, which looks up the old priority by heap position
+            if (pq.has(to)) pq.remove(to);
+            pq.push(to, cost);
+        }
+    };
+    int n_words = current_state.words.size();
+    for (int i = 0; i < core.n_actions; i++) missing[i] = ops.n_preconds(i);
+    for (int w = 0; w < n_words; w++)
+        for (uint64_t bits = current_state.words[w]; bits; bits &= bits - 1)
+            fact_costs[w * 64 + __builtin_ctzll(bits)] = 0;
+    for (int i : core.actions_no_preconds)
+        if (!this->is_used[i]) reach(i, 0);
+    for (int w = 0; w < n_words; w++) {
+        for (uint64_t bits = current_state.words[w]; bits; bits &= bits - 1) {
+            int fact = w * 64 + __builtin_ctzll(bits);
+            for (int idx : core.precond_actions[fact])
+                if (--missing[idx] == 0 && !this->is_used[idx]) reach(idx, 0);
+        }
+    }
+    int total = 0;
+    while (n_open && !pq.isEmpty()) {
+        int fact = pq.top();
+        pq.pop();
+        if (is_goal[fact]) {
+            total = fact_costs[fact];  // the costliest goal so far
+            n_open--;
+        }
+        for (int idx : core.precond_actions[fact])
+            if (--missing[idx] == 0 && !this->is_used[idx])
+                reach(idx, fact_costs[fact]);
+    }
+    pq.clear();
+    for (int goal : goals) is_goal[goal] = 0;
+    release_memory(bytes);
+    return n_open ? inf : total;
+}
+
+int PlanningTask::compute_heuristic(State &current_state, int heuristic) {
+    int total = 0;
+
+    if ((heuristic == 2 || heuristic == 3) && this->core->metric == 0)
+        return rpg_heuristic(current_state);
 
     if (heuristic == 2 || heuristic == 3) {
+        // the cache is shared by all the goals, visited is per goal
+        long long bytes = this->core->n_facts * (sizeof(int) + 2);
+        use_memory(bytes);
+        SearchScratch &scratch = get_scratch();
+        std::vector<int> &cache = scratch.fact_costs;
+        std::vector<char> &cached = scratch.cached;
+        std::vector<char> &visited = scratch.visited;
+        cache.resize(this->core->n_facts);
+        cached.assign(this->core->n_facts, 0);
+        visited.resize(this->core->n_facts);
         for (int i = 0; i < this->n_goals; i++) {
-            std::unordered_set<int> visited;
-            total = std::max(total, h_max(current_state, this->goal_state[i],
-                                          visited, cache));
+            std::fill(visited.begin(), visited.end(), 0);
+            int goal = this->core->fact_id(this->goal_state[i]);
+            total = std::max(
+                total, h_max(current_state, goal, visited, cache, cached));
         }
+        release_memory(bytes);
     }
 
     return total;
 }
 
-void PlanningTask::backward_cost_propagation(
-    std::vector<std::unordered_set<int>> &current_state, int heuristic) {
-    PriorityQueue<int> pq(this->facts.size());
+State PlanningTask::get_initial_state(uint64_t *key) {
+    State state(this->core->n_facts);
+    if (key) *key = 0;
+    for (int i = 0; i < this->initial_state.size(); i++) {
+        int fact = this->core->fact_id(i, this->initial_state[i]);
+        state.add(fact);
+        if (key) *key ^= this->core->fact_keys[fact];
+    }
+    return state;
+}
+
+/*
+    cost combination rules of backward_cost_propagation. reach returns the
+    cost of an action, without its own cost, when it is reached from a fact
+    costing fact_cost; with only_improving the action is skipped if that
+    does not lower its h_cost. A new rule only needs a struct and an entry
+    in the table of backward_cost_propagation
+*/
+struct MinPropagation {  // heuristic 4
+    static const bool only_improving = true;
+    static int reach(const OperatorTable &, int, int fact_cost,
+                     const std::vector<int> &) {
+        return fact_cost;
+    }
+};
+
+struct MaxPropagation {  // heuristic 5
+    static const bool only_improving = false;
+    static int reach(const OperatorTable &ops, int action, int fact_cost,
+                     const std::vector<int> &fact_costs) {
+        int inf = std::numeric_limits<int>::max();
+        int max_cost = fact_cost;
+        for (int e = ops.effect_start[action]; e < ops.effect_start[action + 1];
+             e++)
+            if (fact_costs[ops.effect_to[e]] != inf)
+                max_cost = std::max(max_cost, fact_costs[ops.effect_to[e]]);
+        return max_cost;
+    }
+};
+
+struct SumPropagation {  // heuristic 6
+    static const bool only_improving = false;
+    static int reach(const OperatorTable &ops, int action, int,
+                     const std::vector<int> &fact_costs) {
+        int inf = std::numeric_limits<int>::max();
+        int sum = 0;
+        for (int e = ops.effect_start[action]; e < ops.effect_start[action + 1];
+             e++)
+            if (fact_costs[ops.effect_to[e]] != inf)
+                sum += fact_costs[ops.effect_to[e]];
+        return sum;
+    }
+};
+
+void PlanningTask::backward_cost_propagation(State &current_state,
+                                             int heuristic) {
+    typedef void (PlanningTask::*Propagation)(State &);
+    // [heuristic - 4][metric]
+    static const Propagation table[3][2] = {
+        {&PlanningTask::propagate_costs<MinPropagation, true>,
+         &PlanningTask::propagate_costs<MinPropagation, false>},
+        {&PlanningTask::propagate_costs<MaxPropagation, true>,
+         &PlanningTask::propagate_costs<MaxPropagation, false>},
+        {&PlanningTask::propagate_costs<SumPropagation, true>,
+         &PlanningTask::propagate_costs<SumPropagation, false>}};
+    assert(heuristic >= 4 && heuristic <= 6);
+    assert(this->core->metric == 0 || this->core->metric == 1);
+    (this->*table[heuristic - 4][this->core->metric])(current_state);
+}
+
+template <class Rule, bool unit_cost>
+void PlanningTask::propagate_costs(State &current_state) {
+    long long bytes = this->core->n_facts * 4 * sizeof(int);
+    use_memory(bytes);
+    SearchScratch &scratch = get_scratch();
+    PriorityQueue<int> &pq = scratch.fact_queue;
+    pq.clear();
     int inf = std::numeric_limits<int>::max();
-    std::vector<int> fact_costs(this->facts.size(), inf);
+    std::vector<int> &fact_costs = scratch.fact_costs;
+    fact_costs.assign(this->core->n_facts, inf);
 
     // Initialize goal state facts
     for (int i = 0; i < this->goal_state.size(); i++) {
-        int idx = FIND_FACT_INDEX(this->goal_state[i]);
+        int idx = this->core->fact_id(this->goal_state[i]);
         fact_costs[idx] = 0;
         pq.push(idx, 0);
     }
@@ -381,49 +720,25 @@ void PlanningTask::backward_cost_propagation(
     while (!pq.isEmpty()) {
         int fact_idx = pq.top();
         pq.pop();
-        Fact f = this->facts[fact_idx];
 
-        if (current_state[f.var_idx].count(f.var_val)) continue;
-        std::vector<int> actions = this->map_effect_actions[f];
+        if (current_state.has(fact_idx)) continue;
+        const std::vector<int> &actions = this->core->effect_actions[fact_idx];
+        const OperatorTable &ops = this->core->ops;
 
         for (int i = 0; i < actions.size(); i++) {
-            Action &current_action = this->actions[actions[i]];
-
-            if (current_action.is_used) continue;
-            int new_cost;
-            if (heuristic == 4) {
-                new_cost = (this->metric == 1)
-                               ? current_action.cost + fact_costs[fact_idx]
-                               : 1 + fact_costs[fact_idx];
-
-                if (new_cost >= current_action.h_cost) continue;
-            } else if (heuristic == 5) {
-                int max_cost = fact_costs[fact_idx];
-                for (int j = 0; j < current_action.n_effects; j++) {
-                    Fact eff{current_action.effects[j].var_affected,
-                             current_action.effects[j].to_value};
-                    if (fact_costs[FIND_FACT_INDEX(eff)] != inf)
-                        max_cost = std::max(max_cost,
-                                            fact_costs[FIND_FACT_INDEX(eff)]);
-                }
-                new_cost = this->metric == 1 ? current_action.cost + max_cost
-                                             : 1 + max_cost;
-            } else if (heuristic == 6) {
-                int sum = 0;
-                for (int j = 0; j < current_action.n_effects; j++) {
-                    Fact eff{current_action.effects[j].var_affected,
-                             current_action.effects[j].to_value};
-                    if (fact_costs[FIND_FACT_INDEX(eff)] != inf)
-                        sum += fact_costs[FIND_FACT_INDEX(eff)];
-                }
-                new_cost =
-                    this->metric == 1 ? current_action.cost + sum : 1 + sum;
-            }
+            int action_idx = actions[i];
 
-            current_action.h_cost = new_cost;
-            for (int j = 0; j < current_action.n_preconds; j++) {
-                Fact pre = current_action.preconds[j];
-                int pre_idx = FIND_FACT_INDEX(pre);
+            if (this->is_used[action_idx]) continue;
+            int new_cost = (unit_cost ? 1 : ops.cost[action_idx]) +
+                           Rule::reach(ops, action_idx, fact_costs[fact_idx],
+                                       fact_costs);
+            if (Rule::only_improving && new_cost >= this->h_cost[action_idx])
+                continue;
+
+            this->h_cost[action_idx] = new_cost;
+            for (int j = ops.precond_start[action_idx];
+                 j < ops.precond_start[action_idx + 1]; j++) {
+                int pre_idx = ops.precond_ids[j];
                 if (new_cost < fact_costs[pre_idx]) {
                     fact_costs[pre_idx] = new_cost;
                     if (pq.has(pre_idx))
@@ -434,28 +749,23 @@ void PlanningTask::backward_cost_propagation(
             }
         }
     }
+    release_memory(bytes);
 }
 
-int PlanningTask::apply_pending_effects(
-    std::vector<std::unordered_set<int>> &current_state) {
+int PlanningTask::apply_pending_effects(State &current_state,
+                                        uint64_t *key) {
     int n_applied_effects = 0;
+    const OperatorTable &ops = this->core->ops;
     for (int i = this->pending_effects.size() - 1; i >= 0; i--) {
-        Effect effect = this->pending_effects[i];
-        int j;
-        for (j = 0; j < effect.n_effect_conds; j++) {
-            Fact effect_cond = effect.effect_conds[j];
-            if (!current_state[effect_cond.var_idx].count(
-                    effect_cond.var_val) &&
-                effect_cond.var_val != -1)
-                break;
-        }
-        if (j < effect.n_effect_conds)  // the effect cannot be applied
+        int e = this->pending_effects[i];
+        if (!ops.conds_hold(e, current_state))  // the effect cannot be applied
             continue;
-        int var = effect.var_affected;
-        if ((current_state[var].count(effect.from_value) ||
-             effect.from_value == -1) &&
-            check_mutex_groups(var, effect.to_value, current_state)) {
-            current_state[var].insert(effect.to_value);
+        int from = ops.effect_from[e], to = ops.effect_to[e];
+        if ((from == -1 || current_state.has(from)) &&
+            check_mutex_groups(to, current_state)) {
+            if (key && !current_state.has(to))
+                *key ^= this->core->fact_keys[to];
+            current_state.add(to);
             this->pending_effects.erase(this->pending_effects.begin() + i);
             n_applied_effects++;
         }
@@ -466,91 +776,333 @@ int PlanningTask::apply_pending_effects(
 // apply each possible action
 // re-compute hmax
 // add to h_cost the result of hmax
-void PlanningTask::look_ahead(
-    std::vector<std::unordered_set<int>> &current_state,
-    std::vector<int> &possible_actions_idx, int heuristic) {
-    std::vector<int> costs;
-    for (int i = 0; i < possible_actions_idx.size(); i++)
-        costs.push_back(this->actions[possible_actions_idx[i]].h_cost);
-
-    // simulate action application
-    for (int k = 0; k < possible_actions_idx.size(); k++) {
-        std::vector<std::unordered_set<int>> new_state = current_state;
+void PlanningTask::look_ahead(State &current_state,
+                              std::vector<int> &possible_actions_idx,
+                              int heuristic) {
+    int n = possible_actions_idx.size();
+    // without memory for the successors keep the h_max ranking
+    long long bytes = n * (sizeof(State) + current_state.words.size() * 8);
+    if (!charge_memory(bytes)) return;
+
+    SearchScratch &scratch = get_scratch();
+    std::vector<int> &costs = scratch.costs;
+    costs.clear();
+    for (int i = 0; i < n; i++)
+        costs.push_back(this->h_cost[possible_actions_idx[i]]);
+
+    // simulate action application; the key of a successor is the one of the
+    // current state and the facts added. The successor states keep their
+    // words from one step to the next
+    std::vector<State> &new_states = scratch.successors;
+    if (new_states.size() < n) new_states.resize(n);
+    std::vector<uint64_t> &keys = scratch.keys;
+    keys.clear();
+    if (this->heuristic_cache)
+        keys.assign(n, heuristic_key(this->state_key));
+    for (int k = 0; k < n; k++) {
+        State &new_state = new_states[k];
+        new_state.words.assign(current_state.words.begin(),
+                               current_state.words.end());
         int idx = possible_actions_idx[k];
-        for (int i = 0; i < this->actions[idx].n_effects; i++) {
-            Effect effect = this->actions[idx].effects[i];
-            int j;
-            for (j = 0; j < effect.n_effect_conds; j++) {
-                Fact effect_cond = effect.effect_conds[j];
-                if (!new_state[effect_cond.var_idx].count(
-                        effect_cond.var_val) &&
-                    effect_cond.var_val != -1)
-                    break;
-            }
-            if (j < effect.n_effect_conds)  // the effect cannot be applied
+        const OperatorTable &ops = this->core->ops;
+        for (int e = ops.effect_start[idx]; e < ops.effect_start[idx + 1];
+             e++) {
+            if (!ops.conds_hold(e, new_state))  // the effect cannot be applied
                 continue;
-            int var = effect.var_affected;
-            if ((new_state[var].count(effect.from_value) ||
-                 effect.from_value == -1) &&
-                check_mutex_groups(var, effect.to_value, new_state)) {
-                new_state[var].insert(effect.to_value);
+            int from = ops.effect_from[e], to = ops.effect_to[e];
+            if ((from == -1 || new_state.has(from)) &&
+                check_mutex_groups(to, new_state)) {
+                if (!keys.empty() && !new_state.has(to))
+                    keys[k] ^= this->core->fact_keys[to];
+                new_state.add(to);
             }
         }
+    }
 
+    // the successors found in the cache are not evaluated again. The last
+    // one always is, last, since the actions left out of costs keep the
+    // h_cost of the last evaluation
+    std::vector<int> &totals = scratch.totals;
+    totals.assign(n, 0);
+    std::vector<int> &to_evaluate = scratch.to_evaluate;
+    to_evaluate.clear();
+    for (int k = 0; k < n - 1; k++)
+        if (!this->heuristic_cache ||
+            !this->heuristic_cache->find(keys[k], totals[k]))
+            to_evaluate.push_back(k);
+
+    if (this->core->metric == 0 && (heuristic == 2 || heuristic == 3)) {
+        // unit costs: the successors are evaluated 64 at a time
+        if (!this->rpg)
+            this->rpg = std::make_shared<RelaxedPlanningGraph>(*this->core);
+        std::vector<int> &goals = scratch.goals;
+        goals.clear();
+        for (int i = 0; i < this->n_goals; i++)
+            goals.push_back(this->core->fact_id(this->goal_state[i]));
+        std::vector<State> &batch = scratch.batch;
+        int batch_totals[RelaxedPlanningGraph::batch_size];
+        for (int i = 0; i < to_evaluate.size();
+             i += RelaxedPlanningGraph::batch_size) {
+            int m = std::min<int>(to_evaluate.size() - i,
+                                  RelaxedPlanningGraph::batch_size);
+            // swapped, not moved: both keep their words allocated
+            if (batch.size() < m) batch.resize(m);
+            for (int j = 0; j < m; j++)
+                std::swap(batch[j], new_states[to_evaluate[i + j]]);
+            this->rpg->evaluate_batch(batch.data(), m, this->is_used, goals,
+                                      batch_totals);
+            for (int j = 0; j < m; j++)
+                totals[to_evaluate[i + j]] = batch_totals[j];
+        }
+    } else {
+        for (int k : to_evaluate) {
+            reset_actions_metadata();
+            totals[k] = compute_heuristic(new_states[k], heuristic);
+        }
+    }
+    if (n > 0) {
         reset_actions_metadata();
-        int total = compute_heuristic(new_state, heuristic);
-        costs[k] = total + costs[k] < 0 ? std::numeric_limits<int>::max()
-                                        : total + costs[k];
+        totals[n - 1] = compute_heuristic(new_states[n - 1], heuristic);
+        to_evaluate.push_back(n - 1);
     }
-
-    for (int i = 0; i < possible_actions_idx.size(); i++)
-        this->actions[possible_actions_idx[i]].h_cost = costs[i];
-    possible_actions_idx =
-        get_possible_actions_idx(current_state, true);  // get sorted actions
+    if (this->heuristic_cache)
+        for (int k : to_evaluate)
+            this->heuristic_cache->store(keys[k], totals[k]);
+
+    for (int k = 0; k < n; k++)
+        costs[k] = totals[k] + costs[k] < 0 ? std::numeric_limits<int>::max()
+                                            : totals[k] + costs[k];
+
+    for (int i = 0; i < n; i++)
+        this->h_cost[possible_actions_idx[i]] = costs[i];
+    get_possible_actions_idx(current_state, true,
+                             possible_actions_idx);  // get sorted actions
+    release_memory(bytes);
 }
 
-int PlanningTask::solve(int seed, int heuristic, bool debug, int time_limit) {
-    int pid;
-    if (time_limit != -1) {
-        pid = fork();
-        if (pid == 0) {  // child process
-            sleep(time_limit);
-            std::cerr << "Time limit reached. Killing parent process."
-                      << std::endl;
-            kill(getppid(), SIGTERM);  // Send SIGTERM to the parent process
-            exit(0);                   // Exit child process
+/*
+    relaxed plan extraction: a layered delete-relaxed exploration from the
+    current state records, for every new fact, an achiever in the first layer
+    where the fact appears (axioms and pending effects first, since they are
+    free, then the action with the lowest h_cost). Facts blocked by a mutex
+    group in the current state are never reached.
+    The achievers of the goals, and recursively of their conditions, are
+    then collected backwards; the plan lists them in execution order.
+    Returns false if some goal is unreachable.
+*/
+bool PlanningTask::extract_relaxed_plan(State &current_state,
+                                        std::vector<int> &plan) {
+    const TaskCore &core = *this->core;
+    int inf = std::numeric_limits<int>::max();
+    SearchScratch &scratch = get_scratch();
+    std::vector<int> &layer = scratch.layer;
+    layer.assign(core.n_facts, inf);
+    std::vector<RelaxedAchiever> &achiever = scratch.achiever;
+    achiever.resize(core.n_facts);
+    std::vector<int> &blocked = scratch.blocked;
+    blocked.assign(core.n_facts, -1);  // -1 not computed yet
+    State &reached = scratch.reached;
+    reached = current_state;
+    for (int f = 0; f < core.n_facts; f++)
+        if (current_state.has(f)) layer[f] = 0;
+
+    auto holds = [&](int fact) { return fact == -1 || reached.has(fact); };
+    auto effect_ready = [&](const std::vector<int> &cond_ids, int from_id) {
+        for (int cond : cond_ids)
+            if (!holds(cond)) return false;
+        return holds(from_id);
+    };
+    const OperatorTable &ops = core.ops;
+    auto op_effect_ready = [&](int e) {
+        return ops.conds_hold(e, reached) && holds(ops.effect_from[e]);
+    };
+
+    int k = 0;
+    std::vector<int> &new_facts = scratch.new_facts;
+    while (!goal_reached(reached)) {
+        k++;
+        new_facts.clear();
+        auto offer = [&](int fact, RelaxedAchiever a) {
+            if (reached.has(fact)) return;
+            if (blocked[fact] == -1)
+                blocked[fact] = !check_mutex_groups(fact, current_state);
+            if (blocked[fact]) return;
+            if (layer[fact] != k) {
+                layer[fact] = k;
+                achiever[fact] = a;
+                new_facts.push_back(fact);
+            } else if (a.rank < achiever[fact].rank) {
+                achiever[fact] = a;
+            }
+        };
+
+        for (int i = 0; i < core.n_actions; i++) {
+            if (this->is_used[i]) continue;
+            int j;
+            for (j = ops.precond_start[i]; j < ops.precond_start[i + 1]; j++)
+                if (!reached.has(ops.precond_ids[j])) break;
+            if (j < ops.precond_start[i + 1]) continue;
+            for (int e = ops.effect_start[i]; e < ops.effect_start[i + 1]; e++)
+                if (op_effect_ready(e))
+                    offer(ops.effect_to[e], {0, i, e, this->h_cost[i]});
+        }
+        for (int i = 0; i < core.n_axioms; i++) {
+            const Axiom &axiom = core.axioms[i];
+            if (effect_ready(axiom.cond_ids, axiom.from_id))
+                offer(axiom.to_id, {1, i, -1, -1});
         }
+        for (int i = 0; i < this->pending_effects.size(); i++) {
+            int e = this->pending_effects[i];
+            if (op_effect_ready(e)) offer(ops.effect_to[e], {2, i, e, -1});
+        }
+
+        if (new_facts.empty()) return false;  // fixpoint without the goals
+        for (int f : new_facts) reached.add(f);
     }
 
-    // parent process
-    srand(seed);
-    std::vector<std::unordered_set<int>> current_state(
-        this->initial_state.size());
-    for (int i = 0; i < this->initial_state.size(); i++) {
-        current_state[i].insert(this->initial_state[i]);
+    // backward extraction, layer by layer
+    std::vector<std::vector<int>> &open = scratch.layer_facts;
+    if (open.size() < (size_t)(k + 1)) open.resize(k + 1);
+    for (int i = 0; i <= k; i++) open[i].clear();
+    std::vector<char> &marked = scratch.marked;
+    marked.assign(core.n_facts, 0);
+    auto need = [&](int fact) {
+        if (fact == -1 || layer[fact] == 0 || marked[fact]) return;
+        marked[fact] = 1;
+        open[layer[fact]].push_back(fact);
+    };
+    for (int i = 0; i < this->n_goals; i++)
+        need(core.fact_id(this->goal_state[i]));
+
+    std::vector<int> &action_layer = scratch.action_layer;
+    action_layer.assign(core.n_actions, inf);
+    std::vector<int> &plan_pos = scratch.plan_pos;
+    plan_pos.resize(core.n_actions);
+    plan.clear();
+    for (; k > 0; k--) {
+        for (int fact : open[k]) {
+            const RelaxedAchiever &a = achiever[fact];
+            if (a.type == 0) {
+                for (int j = ops.precond_start[a.idx];
+                     j < ops.precond_start[a.idx + 1]; j++)
+                    need(ops.precond_ids[j]);
+                if (action_layer[a.idx] == inf) {
+                    plan_pos[a.idx] = plan.size();
+                    plan.push_back(a.idx);
+                }
+                action_layer[a.idx] = std::min(action_layer[a.idx], k);
+            } else if (a.type == 1) {
+                const Axiom &axiom = core.axioms[a.idx];
+                for (int cond : axiom.cond_ids) need(cond);
+                need(axiom.from_id);
+                continue;
+            }
+            for (int j = ops.cond_start[a.effect];
+                 j < ops.cond_start[a.effect + 1]; j++)
+                need(ops.cond_ids[j]);
+            need(ops.effect_from[a.effect]);
+        }
     }
+
+    // by layer, then in the order found (a stable sort without the
+    // temporary buffer of std::stable_sort)
+    std::sort(plan.begin(), plan.end(), [&](int a, int b) {
+        if (action_layer[a] != action_layer[b])
+            return action_layer[a] < action_layer[b];
+        return plan_pos[a] < plan_pos[b];
+    });
+    return true;
+}
+
+int PlanningTask::solve(int seed, int heuristic, bool debug) {
+    this->rng.seed(seed);
+    State current_state = get_initial_state(&this->state_key);
+    reset_used_key();
     int estimated_cost = std::numeric_limits<int>::max();
 
     // h_cost = cost in greedy
     if (heuristic == 1) {
-        for (int i = 0; i < this->n_actions; i++) {
-            if (this->metric == 1)
-                this->actions[i].h_cost = this->actions[i].cost;
+        for (int i = 0; i < this->core->n_actions; i++) {
+            if (this->core->metric == 1)
+                this->h_cost[i] = this->core->ops.cost[i];
             else
-                this->actions[i].h_cost = 1;  // greedy becomes random
+                this->h_cost[i] = 1;  // greedy becomes random
         }
     }
 
-    std::cout << "Creating structs...";
-    create_structs();
-    std::cout << "Done" << std::endl;
-
     bool no_solution = false;
+    bool timed_out = false;
+    bool pruned = false;
+    // stored backwards, next action last
+    std::vector<int> &relaxed_plan = get_scratch().relaxed_plan;
+    relaxed_plan.clear();
+    int n_propagations = 0;
+    long long pending_bytes = 0;
 
     while (!goal_reached(current_state)) {
-        apply_axioms(current_state);
-        if (int n = apply_pending_effects(current_state))
-            std::cout << "Applied " << n << " pending effects" << std::endl;
+        if (deadline_passed()) {
+            timed_out = true;
+            break;
+        }
+        if (this->solution_cost >= this->cost_bound) {
+            pruned = true;
+            break;
+        }
+        long long bytes = this->pending_effects.capacity() * sizeof(int);
+        use_memory(bytes - pending_bytes);
+        pending_bytes = bytes;
+
+        apply_axioms(current_state, &this->state_key);
+        int n_pending = apply_pending_effects(current_state, &this->state_key);
+        if (n_pending && this->log)
+            *this->log << "Applied " << n_pending << " pending effects"
+                       << std::endl;
+
+        // follow a relaxed plan, propagate again only when it breaks
+        if (heuristic == 9) {
+            if (relaxed_plan.empty()) {
+                reset_actions_metadata();
+                backward_cost_propagation(current_state, 4);
+                n_propagations++;
+                if (!extract_relaxed_plan(current_state, relaxed_plan)) {
+                    no_solution = true;
+                    break;
+                }
+                std::reverse(relaxed_plan.begin(), relaxed_plan.end());
+            }
+            if (relaxed_plan.empty()) {
+                // only axioms and pending effects are left to apply
+                State &before = get_scratch().before;
+                before.words = current_state.words;
+                apply_axioms(current_state, &this->state_key);
+                apply_pending_effects(current_state, &this->state_key);
+                if (current_state.words == before.words) {
+                    no_solution = true;
+                    break;
+                }
+                continue;
+            }
+
+            int idx = relaxed_plan.back();
+            relaxed_plan.pop_back();
+            const OperatorTable &ops = this->core->ops;
+            int j, n_true = 0;
+            for (j = ops.precond_start[idx]; j < ops.precond_start[idx + 1];
+                 j++)
+                if (!current_state.has(ops.precond_ids[j])) break;
+            for (int e = ops.effect_start[idx]; e < ops.effect_start[idx + 1];
+                 e++)
+                if (current_state.has(ops.effect_to[e])) n_true++;
+            if (n_true == ops.n_effects(idx)) {
+                mark_used(idx);  // achieved by someone else
+            } else if (j < ops.precond_start[idx + 1]) {
+                relaxed_plan.clear();  // not executable (yet)
+            } else if (!apply_action(idx, current_state)) {
+                mark_used(idx);  // blocked, do not pick it again
+                relaxed_plan.clear();
+            }
+            continue;
+        }
 
         // calculate heuristic costs
         if (heuristic == 2 || heuristic == 3) {
@@ -558,8 +1110,9 @@ int PlanningTask::solve(int seed, int heuristic, bool debug, int time_limit) {
             int total = compute_heuristic(current_state, heuristic);
             if (total < estimated_cost) {
                 estimated_cost = total;
-                std::cout << "New estimated cost: " << estimated_cost
-                          << std::endl;
+                if (this->log)
+                    *this->log << "New estimated cost: " << estimated_cost
+                               << std::endl;
             }
         }
 
@@ -569,13 +1122,13 @@ int PlanningTask::solve(int seed, int heuristic, bool debug, int time_limit) {
         }
 
         // get possible actions
-        std::vector<int> possible_actions_idx =
-            get_possible_actions_idx(current_state, true);
+        std::vector<int> &possible_actions_idx = get_scratch().possible_actions;
+        get_possible_actions_idx(current_state, true, possible_actions_idx);
 
         // if the first action has infinite cost, the problem is
         // infeasible (beacuse possible_actions_idx is sorted)
         if (possible_actions_idx.empty() ||
-            (heuristic > 0 && this->actions[possible_actions_idx[0]].h_cost ==
+            (heuristic > 0 && this->h_cost[possible_actions_idx[0]] ==
                                   std::numeric_limits<int>::max())) {
             no_solution = true;
             break;
@@ -604,15 +1157,15 @@ int PlanningTask::solve(int seed, int heuristic, bool debug, int time_limit) {
             int idx;
             if (heuristic == 0) {
                 idx = PlanningTaskUtils::get_random_number(
-                    0, possible_actions_idx.size());
+                    this->rng, 0, possible_actions_idx.size());
             } else {
                 int i = 0;
-                int min_cost = this->actions[possible_actions_idx[0]].h_cost;
+                int min_cost = this->h_cost[possible_actions_idx[0]];
                 while (i < possible_actions_idx.size() &&
-                       this->actions[possible_actions_idx[i]].h_cost ==
+                       this->h_cost[possible_actions_idx[i]] ==
                            min_cost)
                     i++;
-                idx = PlanningTaskUtils::get_random_number(0, i);
+                idx = PlanningTaskUtils::get_random_number(this->rng, 0, i);
             }
 
             action_to_apply_idx = possible_actions_idx[idx];
@@ -624,171 +1177,566 @@ int PlanningTask::solve(int seed, int heuristic, bool debug, int time_limit) {
         // std::cout << "APPLIED ACTION: " << action_to_apply_idx << std::endl;
     }
 
-    if (time_limit != -1) {
-        kill(pid, SIGTERM);
-    }
+    release_memory(pending_bytes);
+    if (timed_out) return -2;
+    if (pruned) return -3;
+
+    if (heuristic == 9 && this->log)
+        *this->log << "Cost propagations: " << n_propagations << std::endl;
 
     if (no_solution) return -1;
 
-    if (debug) {
-        if (check_integrity())
-            std::cout << "Integrity check passed!" << std::endl;
+    if (debug && this->log) {
+        std::string error;
+        if (check_integrity(&error))
+            *this->log << "Integrity check passed!" << std::endl;
         else
-            std::cout << "Integrity check NOT passed!" << std::endl;
+            *this->log << "Integrity check NOT passed! " << error
+                       << std::endl;
     }
 
     return 0;
 }
 
-bool PlanningTask::check_integrity() {
-    std::vector<std::unordered_set<int>> current_state(
-        this->initial_state.size());
-    for (int i = 0; i < this->initial_state.size(); i++) {
-        current_state[i].insert(this->initial_state[i]);
-    }
-    int cost = 0;
-    for (int k = 0; k < this->solution.size(); k++) {
-        IndexAction indexAction = this->solution[k];
-        std::vector<int> actions_idx =
-            get_possible_actions_idx(current_state, false);
-        int p = 0;
-        for (; p < actions_idx.size(); p++) {
-            if (actions_idx[p] == indexAction.idx) break;
-        }
-        if (p == actions_idx.size())
-            return false;  // action not applicable at this point
-        for (int i = 0; i < indexAction.action.n_effects; i++) {
-            Effect effect = indexAction.action.effects[i];
-            int j;
-            for (j = 0; j < effect.n_effect_conds; j++) {
-                std::vector<Fact> effect_conds = effect.effect_conds;
-                if (!current_state[effect_conds[j].var_idx].count(
-                        effect_conds[j].var_val) &&
-                    effect_conds[j].var_val != -1)
-                    break;
-            }
-            if (j < effect.n_effect_conds)  // the effect cannot be applied
-                continue;
-            int var = effect.var_affected;
-            if ((current_state[var].count(effect.from_value) ||
-                 effect.from_value == -1) &&
-                check_mutex_groups(var, effect.to_value, current_state)) {
-                current_state[var].insert(effect.to_value);
-            }
+/*
+    Restarts of solve on the same core: each run starts again from the
+    metadata the task had on entry (used actions, pending effects, partial
+    solution), only with the next seed, and is cut off as soon as its plan
+    costs as much as the best one so far
+*/
+int PlanningTask::solve_restarts(int seed, int heuristic, bool debug,
+                                 int n_runs) {
+    SearchScratch &scratch = get_scratch();
+    std::vector<char> &start_is_used = scratch.start_is_used;
+    std::vector<int> &start_pending = scratch.start_pending;
+    std::vector<int> &start_solution = scratch.start_solution;
+    std::vector<int> &best_solution = scratch.best_solution;
+    start_is_used = this->is_used;
+    start_pending = this->pending_effects;
+    start_solution = this->solution;
+    int start_cost = this->solution_cost;
+
+    best_solution.clear();
+    int best_cost = std::numeric_limits<int>::max();
+    bool found = false, timed_out = false;
+    for (int run = 0; run < n_runs; run++) {
+        this->is_used = start_is_used;
+        this->pending_effects = start_pending;
+        this->solution = start_solution;
+        this->solution_cost = start_cost;
+        this->cost_bound = best_cost;
+        int res = solve(seed + run, heuristic, debug);
+        if (this->log) {
+            *this->log << "Restart " << run << " (seed " << seed + run
+                       << "): ";
+            if (res == 0)
+                *this->log << "cost " << this->solution_cost << std::endl;
+            else if (res == -1)
+                *this->log << "no solution" << std::endl;
+            else if (res == -2)
+                *this->log << "timelimit reached" << std::endl;
+            else
+                *this->log << "pruned at cost " << this->solution_cost
+                           << std::endl;
         }
-        cost += this->actions[indexAction.idx].cost;
-    }
-    if (cost == this->solution_cost) return true;
-    return false;
-}
-
-// Encode a delete-free state (vector of sets)
-std::string encode(const std::vector<std::unordered_set<int>> &state) {
-    if (state.empty()) return "";
-
-    std::string key;
-    for (size_t i = 0; i < state.size(); ++i) {
-        std::vector<int> vals(state[i].begin(), state[i].end());
-        std::sort(vals.begin(), vals.end());  // deterministic order
-        std::string var_str;
-        for (size_t j = 0; j < vals.size(); ++j) {
-            if (j > 0) var_str += ",";
-            var_str += std::to_string(vals[j]);
+        if (res == -2) {
+            timed_out = true;
+            break;
+        }
+        if (res == 0 && this->solution_cost < best_cost) {
+            best_solution = this->solution;
+            best_cost = this->solution_cost;
+            found = true;
         }
-        if (i > 0) key += "|";  // separator between variables
-        key += var_str;
     }
-    return key;
+    this->cost_bound = std::numeric_limits<int>::max();
+    if (!found) return timed_out ? -2 : -1;
+
+    this->is_used = start_is_used;
+    reset_used_key();
+    for (int idx : best_solution) mark_used(idx);
+    this->pending_effects.clear();
+    this->solution = best_solution;
+    this->solution_cost = best_cost;
+    return 0;
 }
 
-// Decode string into a vector of sets
-std::vector<std::unordered_set<int>> decode(const std::string &s) {
-    std::vector<std::unordered_set<int>> state;
-    if (s.empty()) return state;
+/*
+    replay the solution with PlanValidator; on failure error (if given) tells
+    the failing step and why
+*/
+bool PlanningTask::check_integrity(std::string *error) {
+    PlanValidator validator(*this->core);
+    if (validator.validate(this->initial_state, this->goal_state,
+                           this->solution, this->solution_cost))
+        return true;
+    if (error)
+        *error = "step " + std::to_string(validator.failed_step) + ": " +
+                 validator.error;
+    return false;
+}
 
-    std::istringstream ss(s);
-    std::string var_str;
-    while (std::getline(ss, var_str, '|')) {
-        std::unordered_set<int> var_set;
-        std::istringstream vs(var_str);
-        std::string val;
-        while (std::getline(vs, val, ',')) {
-            if (!val.empty()) var_set.insert(std::stoi(val));
-        }
-        state.push_back(var_set);
+/*
+    admissible (delete relaxed) bound on the cost of a plan: the exact h_max
+    of the initial state, INT_MAX if the goal is unreachable. Every action
+    counts, used or not, so the bound is cached on the facts and goals alone
+    and is shared by restarts and by windows with the same start and goals.
+    The h_cost of the actions may be overwritten
+*/
+int PlanningTask::lower_bound() {
+    uint64_t key;
+    State state = get_initial_state(&key);
+    apply_axioms(state, &key);
+    int total;
+    if (this->heuristic_cache) {
+        key = bound_key(key);
+        if (this->heuristic_cache->find(key, total)) return total;
     }
-    return state;
+    std::vector<char> used(this->core->n_actions, 0);
+    this->is_used.swap(used);
+    reset_actions_metadata();
+    total = this->core->metric == 0 ? rpg_heuristic(state)
+                                    : weighted_h_max(state);
+    this->is_used.swap(used);
+    if (this->heuristic_cache) this->heuristic_cache->store(key, total);
+    return total;
 }
 
+/*
+    returns 0 if solved, 1 if there is no solution and -1 if the node budget
+    or the memory limit is reached
+*/
 int PlanningTask::ucs() {
-    const int MAX_STATES = 500000;
+    const int MAX_STATES = ucs_max_states;
+    const int n_words = (this->core->n_facts + 63) / 64;
+    // frontier, then per state: node, facts, expanded flag and up to four
+    // slots of the hash table
+    long long charged = 3 * (long long)MAX_STATES * sizeof(int);
+    long long state_bytes =
+        sizeof(UcsNode) + n_words * sizeof(uint64_t) + 1 + 4 * sizeof(int);
+    if (!charge_memory(charged)) return -1;
+    auto finish = [&](int res) {
+        release_memory(charged);
+        return res;
+    };
+
     PriorityQueue<int> frontier(MAX_STATES);  // arbitrary size of the queue
     std::vector<UcsNode> states;              // get state from index
-    std::unordered_map<std::string, int> map_state_idx;  // get index from state
-    std::unordered_set<int> visited;                     // expanded states
-
-    int next_state_to_add_idx = 0;
-    std::vector<std::unordered_set<int>> init_state(this->initial_state.size());
-    for (size_t i = 0; i < this->initial_state.size(); ++i) {
-        init_state[i].insert(this->initial_state[i]);
-    }
-
-    // Encode the multi-valued initial state
-    std::string enc_init_state = encode(init_state);
-    map_state_idx[enc_init_state] = next_state_to_add_idx++;
-    states.push_back({enc_init_state, -1, -1, 0});
-    frontier.push(map_state_idx[enc_init_state], 0);
-
+    std::vector<uint64_t> state_words;  // facts of state i at i * n_words
+    std::vector<char> expanded;
+
+    // index from state: open addressing on the Zobrist key, holding index +
+    // 1 (0 for an empty slot); states with the same key are told apart by
+    // their facts
+    std::vector<int> table(1024, 0);
+    auto slot = [&](const State &state, uint64_t key) -> int & {
+        size_t mask = table.size() - 1;
+        for (size_t i = key & mask;; i = (i + 1) & mask) {
+            int idx = table[i] - 1;
+            if (idx == -1 ||
+                (states[idx].key == key &&
+                 std::equal(state.words.begin(), state.words.end(),
+                            state_words.begin() + (size_t)idx * n_words)))
+                return table[i];
+        }
+    };
+    auto grow = [&]() {
+        std::vector<int> old_table(2 * table.size(), 0);
+        old_table.swap(table);
+        size_t mask = table.size() - 1;
+        for (int entry : old_table) {
+            if (!entry) continue;
+            size_t i = states[entry - 1].key & mask;
+            while (table[i]) i = (i + 1) & mask;
+            table[i] = entry;
+        }
+    };
+    auto add_state = [&](const State &state, const UcsNode &node) {
+        states.push_back(node);
+        state_words.insert(state_words.end(), state.words.begin(),
+                           state.words.end());
+        expanded.push_back(0);
+        frontier.push(states.size() - 1, node.cost);
+        return (int)states.size();
+    };
+
+    State init_state = get_initial_state();
+    uint64_t init_key = this->core->facts_key(init_state);
+    slot(init_state, init_key) = add_state(init_state, {init_key, -1, -1, 0});
+
+    State current_state(this->core->n_facts);
+    State new_state(this->core->n_facts);
+    std::vector<int> successors;
     while (!frontier.isEmpty()) {
+        if (deadline_passed()) return finish(-2);
         int state_idx = frontier.top();
         frontier.pop();
 
-        std::vector<std::unordered_set<int>> current_state =
-            decode(states[state_idx].state);
+        std::copy(state_words.begin() + (size_t)state_idx * n_words,
+                  state_words.begin() + (size_t)(state_idx + 1) * n_words,
+                  current_state.words.begin());
         if (goal_reached(current_state)) {
             this->solution_cost = states[state_idx].cost;
             while (state_idx != -1) {
                 int a_idx = states[state_idx].action_idx;
-                if (a_idx != -1)
-                    this->solution.push_back({a_idx, this->actions[a_idx]});
+                if (a_idx != -1) this->solution.push_back(a_idx);
                 state_idx = states[state_idx].parent_idx;
             }
             std::reverse(this->solution.begin(), this->solution.end());
-            return 0;
+            return finish(0);
         }
 
-        if (visited.count(state_idx))
+        if (expanded[state_idx])
             continue;  // do not expand a node already expanded
+        expanded[state_idx] = 1;
 
-        visited.insert(state_idx);
-
-        std::vector<int> successors =
-            get_possible_actions_idx(current_state, true);
+        get_possible_actions_idx(current_state, true, successors);
 
         for (int a_idx : successors) {
-            std::vector<std::unordered_set<int>> new_state = current_state;
-            compute_next_state(a_idx, new_state);
-
-            std::string enc_state = encode(new_state);
-            int cost = (this->metric == 1)
-                           ? states[state_idx].cost + this->actions[a_idx].cost
-                           : states[state_idx].cost + 1;
-
-            if (!map_state_idx.count(enc_state)) {
-                if (next_state_to_add_idx >= MAX_STATES)
-                    return -1;  // out of capacity
-                map_state_idx[enc_state] = next_state_to_add_idx++;
-                states.push_back({enc_state, state_idx, a_idx, cost});
-                frontier.push(map_state_idx[enc_state], cost);
-            } else if (!visited.count(map_state_idx[enc_state]) &&
-                       cost < states[map_state_idx[enc_state]].cost) {
+            // successor key: parent key and the facts added
+            new_state.words = current_state.words;
+            uint64_t key = states[state_idx].key;
+            compute_next_state(a_idx, new_state, &key);
+
+            int cost =
+                (this->core->metric == 1)
+                    ? states[state_idx].cost + this->core->ops.cost[a_idx]
+                    : states[state_idx].cost + 1;
+
+            int &entry = slot(new_state, key);
+            if (!entry) {
+                if (states.size() >= MAX_STATES ||
+                    !charge_memory(state_bytes))
+                    return finish(-1);  // out of capacity
+                charged += state_bytes;
+                entry = add_state(new_state, {key, state_idx, a_idx, cost});
+                if (2 * states.size() > table.size()) grow();
+            } else if (!expanded[entry - 1] &&
+                       cost < states[entry - 1].cost) {
                 // overwrite old entry with lower cost
-                int idx = map_state_idx[enc_state];
-                states[idx] = {enc_state, state_idx, a_idx, cost};
+                int idx = entry - 1;
+                states[idx] = {key, state_idx, a_idx, cost};
                 frontier.change(idx,
                                 cost);  // the state is already in the frontier
             }
         }
     }
-    return 1;  // no solution
+    return finish(1);  // no solution
+}
+
+// open node of branch_and_bound, branching on the achievers of fact
+class BranchChoice {
+   public:
+    int fact;
+    std::vector<int> achievers;  // free ones, by increasing h_max
+    int next;                    // next child, achievers.size() for the last
+    int trail_size;              // decisions of the node
+    int bound;                   // lower bound of the node
+};
+
+/*
+    branch and bound on the set of actions of a plan: in a delete-free task
+    a plan is a set of actions applied in an order that keeps them
+    applicable, so a node only decides which actions are included and which
+    are excluded. The included actions are applied while some of them is
+    applicable (the closure of the node); if that reaches the goals, the
+    node is a plan. Otherwise its bound is the cost of the included actions
+    plus h_max from the closure, with the included actions free and the
+    excluded ones removed, and the node branches on a fact of the h_max
+    relaxed plan whose achiever is not included (the one with the fewest
+    free achievers): child k includes achiever k and excludes the previous
+    ones, the last child excludes them all.
+
+    The bound ignores effect conditions, from values and mutex groups. A
+    node whose relaxed plan is all included but whose closure is blocked by
+    them is not expanded, and its bound is kept in the proven one. The
+    search is depth first; nodes whose bound reaches the cost of the best
+    plan are pruned
+*/
+int PlanningTask::branch_and_bound(bool incumbent) {
+    const TaskCore &core = *this->core;
+    const OperatorTable &ops = core.ops;
+    const int inf = std::numeric_limits<int>::max();
+    auto action_cost = [&](int a) {
+        return core.metric == 1 ? ops.cost[a] : 1;
+    };
+
+    PlanValidator validator(core);
+    int best_cost = inf;
+    std::vector<int> best_plan;
+    if (incumbent) {
+        if (validator.validate(this->initial_state, this->goal_state,
+                               this->solution, this->solution_cost)) {
+            best_cost = this->solution_cost;
+            best_plan = this->solution;
+        } else if (this->log) {
+            *this->log << "Incumbent not valid (step " << validator.failed_step
+                       << ": " << validator.error << "), ignored" << std::endl;
+        }
+    }
+
+    long long bytes = (long long)core.n_facts * (3 * sizeof(int) + 1) +
+                      (long long)core.n_actions * (sizeof(int) + 2);
+    use_memory(bytes);
+
+    // axioms by condition, for h_max
+    std::vector<std::vector<int>> cond_axioms(core.n_facts);
+    for (int x = 0; x < core.n_axioms; x++)
+        for (int cond : core.axioms[x].cond_ids) cond_axioms[cond].push_back(x);
+
+    // status of an action: 0 free, 1 included, 2 excluded; the trail lists
+    // the decided actions in order
+    std::vector<char> status(core.n_actions, 0), applied(core.n_actions, 0);
+    std::vector<int> trail;
+    int included_cost = 0;
+    auto decide = [&](int a, char s) {
+        status[a] = s;
+        trail.push_back(a);
+        if (s == 1) included_cost += action_cost(a);
+    };
+    auto undo = [&](int size) {
+        while (trail.size() > size) {
+            int a = trail.back();
+            trail.pop_back();
+            if (status[a] == 1) included_cost -= action_cost(a);
+            status[a] = 0;
+        }
+    };
+
+    // the included actions applied while possible, in plan, as solve would
+    State state(core.n_facts);
+    std::vector<int> plan;
+    auto closure = [&]() {
+        state = get_initial_state();
+        this->pending_effects.clear();
+        plan.clear();
+        while (true) {
+            apply_axioms(state);
+            int n_applied = apply_pending_effects(state);
+            int next = -1;
+            for (int a : trail) {
+                if (status[a] != 1 || applied[a]) continue;
+                int j;
+                for (j = ops.precond_start[a]; j < ops.precond_start[a + 1];
+                     j++)
+                    if (!state.has(ops.precond_ids[j])) break;
+                if (j == ops.precond_start[a + 1]) {
+                    next = a;
+                    break;
+                }
+            }
+            if (next == -1) {
+                if (!n_applied) break;
+                continue;
+            }
+            compute_next_state(next, state);
+            applied[next] = 1;
+            plan.push_back(next);
+        }
+        for (int a : plan) applied[a] = 0;
+    };
+
+    // h_max of the goals from the closure; achiever of a fact: action a as
+    // a, axiom x as -2 - x, -1 for the facts of the closure
+    std::vector<int> fact_cost(core.n_facts), achiever(core.n_facts);
+    std::vector<int> missing(core.n_actions), axiom_missing(core.n_axioms);
+    PriorityQueue<int> queue(core.n_facts);
+    auto reach = [&](int fact, int cost, int by) {
+        if (cost >= fact_cost[fact]) return;
+        fact_cost[fact] = cost;
+        achiever[fact] = by;
+        if (queue.has(fact))
+            queue.change(fact, cost);
+        else
+            queue.push(fact, cost);
+    };
+    auto reach_action = [&](int a, int cost) {
+        if (status[a] == 2) return;
+        if (status[a] == 0) cost += action_cost(a);
+        for (int e = ops.effect_start[a]; e < ops.effect_start[a + 1]; e++)
+            reach(ops.effect_to[e], cost, a);
+    };
+    auto relaxed_cost = [&]() {
+        std::fill(fact_cost.begin(), fact_cost.end(), inf);
+        for (int f = 0; f < core.n_facts; f++)
+            if (state.has(f)) reach(f, 0, -1);
+        for (int x = 0; x < core.n_axioms; x++) {
+            const Axiom &axiom = core.axioms[x];
+            axiom_missing[x] = axiom.cond_ids.size();
+            if (axiom.cond_ids.empty()) reach(axiom.to_id, 0, -2 - x);
+        }
+        for (int a = 0; a < core.n_actions; a++) {
+            missing[a] = ops.n_preconds(a);
+            if (!missing[a]) reach_action(a, 0);
+        }
+        while (!queue.isEmpty()) {
+            int f = queue.top();
+            queue.pop();
+            for (int a : core.precond_actions[f])
+                if (--missing[a] == 0) reach_action(a, fact_cost[f]);
+            for (int x : cond_axioms[f])
+                if (--axiom_missing[x] == 0)
+                    reach(core.axioms[x].to_id, fact_cost[f], -2 - x);
+        }
+        int h = 0;
+        for (int i = 0; i < this->n_goals; i++)
+            h = std::max(h, fact_cost[core.fact_id(this->goal_state[i])]);
+        return h;
+    };
+
+    // the fact to branch on, -1 if every achiever of the relaxed plan is
+    // included
+    std::vector<char> marked(core.n_facts, 0);
+    std::vector<int> open, relaxed_facts;
+    auto branching_fact = [&]() {
+        auto need = [&](int fact) {
+            if (achiever[fact] == -1 || marked[fact]) return;
+            marked[fact] = 1;
+            open.push_back(fact);
+            relaxed_facts.push_back(fact);
+        };
+        for (int i = 0; i < this->n_goals; i++)
+            need(core.fact_id(this->goal_state[i]));
+        int best = -1, best_free = inf;
+        while (!open.empty()) {
+            int f = open.back();
+            open.pop_back();
+            int by = achiever[f];
+            if (by <= -2) {
+                for (int cond : core.axioms[-2 - by].cond_ids) need(cond);
+                continue;
+            }
+            for (int j = ops.precond_start[by]; j < ops.precond_start[by + 1];
+                 j++)
+                need(ops.precond_ids[j]);
+            if (status[by] == 1) continue;
+            int n_free = 0;
+            for (int a : core.effect_actions[f]) n_free += status[a] == 0;
+            if (n_free < best_free ||
+                (n_free == best_free && fact_cost[f] > fact_cost[best])) {
+                best = f;
+                best_free = n_free;
+            }
+        }
+        for (int f : relaxed_facts) marked[f] = 0;
+        relaxed_facts.clear();
+        return best;
+    };
+
+    // the free achievers of fact that h_max reaches, cheapest first
+    std::vector<std::pair<int, int>> ranked;
+    auto free_achievers = [&](int fact, std::vector<int> &achievers) {
+        ranked.clear();
+        for (int a : core.effect_actions[fact]) {
+            if (status[a]) continue;
+            int h = 0;
+            for (int j = ops.precond_start[a]; j < ops.precond_start[a + 1];
+                 j++)
+                h = std::max(h, fact_cost[ops.precond_ids[j]]);
+            if (h != inf) ranked.push_back({h + action_cost(a), a});
+        }
+        std::sort(ranked.begin(), ranked.end());
+        ranked.erase(std::unique(ranked.begin(), ranked.end()), ranked.end());
+        for (const std::pair<int, int> &r : ranked)
+            achievers.push_back(r.second);
+    };
+
+    if (this->log) {
+        *this->log << "Branch and bound from ";
+        if (best_cost == inf)
+            *this->log << "no incumbent" << std::endl;
+        else
+            *this->log << "incumbent cost " << best_cost << std::endl;
+    }
+    std::vector<BranchChoice> choices;
+    long long n_nodes = 0, n_pruned = 0, n_blocked = 0;
+    int blocked_bound = inf;  // least bound of the blocked nodes
+    bool timed_out = false;
+    while (true) {
+        if (deadline_passed()) {
+            timed_out = true;
+            break;
+        }
+        n_nodes++;
+        closure();
+        if (goal_reached(state)) {
+            int cost = 0;
+            for (int a : plan) cost += action_cost(a);
+            if (cost < best_cost) {
+                if (validator.validate(this->initial_state, this->goal_state,
+                                       plan, cost)) {
+                    best_cost = cost;
+                    best_plan = plan;
+                    if (this->log)
+                        *this->log << "New incumbent: cost " << cost
+                                   << " at node " << n_nodes << std::endl;
+                } else {
+                    n_blocked++;
+                    blocked_bound = std::min(blocked_bound, included_cost);
+                }
+            }
+        } else {
+            int h = relaxed_cost();
+            int bound = h == inf ? inf : included_cost + h;
+            if (n_nodes == 1 && this->log)
+                *this->log << "Root bound: " << bound << std::endl;
+            int fact = bound < best_cost ? branching_fact() : -1;
+            if (bound >= best_cost) {
+                n_pruned++;
+            } else if (fact == -1) {
+                n_blocked++;
+                blocked_bound = std::min(blocked_bound, bound);
+            } else {
+                choices.push_back({fact, {}, 0, (int)trail.size(), bound});
+                free_achievers(fact, choices.back().achievers);
+            }
+        }
+
+        // next child of the deepest node with one left
+        while (!choices.empty() &&
+               choices.back().next > choices.back().achievers.size())
+            choices.pop_back();
+        if (choices.empty()) break;
+        BranchChoice &choice = choices.back();
+        undo(choice.trail_size);
+        for (int k = 0; k < choice.next; k++) decide(choice.achievers[k], 2);
+        if (choice.next < choice.achievers.size())
+            decide(choice.achievers[choice.next], 1);
+        choice.next++;
+    }
+    release_memory(bytes);
+    this->pending_effects.clear();
+
+    // the nodes left open by the deadline are bounded by their parents
+    int bound = std::min(best_cost, blocked_bound);
+    for (const BranchChoice &choice : choices)
+        bound = std::min(bound, choice.bound);
+    if (timed_out && n_nodes == 0) bound = 0;
+    this->proven_bound = bound;
+    if (this->log) {
+        *this->log << "Nodes: " << n_nodes << ", pruned: " << n_pruned
+                   << ", blocked: " << n_blocked << std::endl;
+        if (timed_out) *this->log << "Timelimit reached" << std::endl;
+        if (best_cost == inf)
+            *this->log << "No plan found" << std::endl;
+        else if (bound == best_cost)
+            *this->log << "Proven optimal: cost " << best_cost << std::endl;
+        else
+            *this->log << "Lower bound: " << bound << ", cost: " << best_cost
+                       << ", gap: "
+                       << 100.0 * (best_cost - bound) / best_cost << "%"
+                       << std::endl;
+    }
+
+    if (best_cost == inf) {
+        this->solution.clear();
+        this->solution_cost = 0;
+        return timed_out ? -2 : -1;
+    }
+    this->solution = best_plan;
+    this->solution_cost = best_cost;
+    this->is_used.assign(core.n_actions, false);
+    this->used_key = 0;
+    for (int idx : best_plan) mark_used(idx);
+    return 0;
 }
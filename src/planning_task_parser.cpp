@@ -6,7 +6,7 @@
 #include <stdexcept>
 #include <vector>
 
-void PlanningTaskParser::assert_version(std::ifstream &file) {
+void PlanningTaskParser::assert_version(std::istream &file) {
     std::string line;
 
     // the translator version must be 3
@@ -18,7 +18,7 @@ void PlanningTaskParser::assert_version(std::ifstream &file) {
     assert(line == "end_version");
 }
 
-int PlanningTaskParser::get_metric(std::ifstream &file) {
+int PlanningTaskParser::get_metric(std::istream &file) {
     std::string line;
 
     // the metric must be 0 or 1
@@ -33,7 +33,7 @@ int PlanningTaskParser::get_metric(std::ifstream &file) {
     return metric;
 }
 
-std::vector<Variable> PlanningTaskParser::get_variables(std::ifstream &file) {
+std::vector<Variable> PlanningTaskParser::get_variables(std::istream &file) {
     std::vector<Variable> vars;
     std::string line;
 
@@ -80,7 +80,7 @@ Fact PlanningTaskParser::parse_fact(std::string line) {
     return fact;
 }
 
-std::vector<MutexGroup> PlanningTaskParser::get_facts(std::ifstream &file) {
+std::vector<MutexGroup> PlanningTaskParser::get_facts(std::istream &file) {
     std::vector<MutexGroup> mutexes;
     std::string line;
 
@@ -110,7 +110,7 @@ std::vector<MutexGroup> PlanningTaskParser::get_facts(std::ifstream &file) {
     return mutexes;
 }
 
-std::vector<int> PlanningTaskParser::get_initial_state(std::ifstream &file,
+std::vector<int> PlanningTaskParser::get_initial_state(std::istream &file,
                                                        int n_vars) {
     std::vector<int> initial_state;
     std::string line;
@@ -130,7 +130,7 @@ std::vector<int> PlanningTaskParser::get_initial_state(std::ifstream &file,
     return initial_state;
 }
 
-std::vector<Fact> PlanningTaskParser::get_goal(std::ifstream &file) {
+std::vector<Fact> PlanningTaskParser::get_goal(std::istream &file) {
     std::vector<Fact> goal_state;
     std::string line;
     getline(file, line);
@@ -152,7 +152,7 @@ std::vector<Fact> PlanningTaskParser::get_goal(std::ifstream &file) {
     return goal_state;
 }
 
-std::vector<Action> PlanningTaskParser::get_actions(std::ifstream &file) {
+std::vector<Action> PlanningTaskParser::get_actions(std::istream &file) {
     std::vector<Action> actions;
     std::string line;
 
@@ -164,6 +164,7 @@ std::vector<Action> PlanningTaskParser::get_actions(std::ifstream &file) {
         assert(line == "begin_operator");
 
         Action action;
+        action.original_idx = i;
         getline(file, action.name);
 
         getline(file, line);
@@ -213,8 +214,6 @@ std::vector<Action> PlanningTaskParser::get_actions(std::ifstream &file) {
 
         getline(file, line);
         action.cost = std::stoi(line);
-        action.is_used = false;
-        action.h_cost = std::numeric_limits<int>::max();
         actions.push_back(action);
 
         getline(file, line);
@@ -225,7 +224,7 @@ std::vector<Action> PlanningTaskParser::get_actions(std::ifstream &file) {
     return actions;
 }
 
-std::vector<Axiom> PlanningTaskParser::get_axioms(std::ifstream &file) {
+std::vector<Axiom> PlanningTaskParser::get_axioms(std::istream &file) {
     std::vector<Axiom> axioms;
     std::string line;
     getline(file, line);
@@ -268,13 +267,18 @@ std::vector<Axiom> PlanningTaskParser::get_axioms(std::ifstream &file) {
     return axioms;
 }
 
-PlanningTask PlanningTaskParser::parse_from_file(std::string filename) {
+PlanningTask PlanningTaskParser::parse_from_file(std::string filename,
+                                                 bool preprocess) {
     std::ifstream file(filename);
 
     if (!file.is_open()) {
         throw std::runtime_error("Failed to open the file");
     }
 
+    return parse(file, preprocess);
+}
+
+PlanningTask PlanningTaskParser::parse(std::istream &file, bool preprocess) {
     assert_version(file);
     int metric = get_metric(file);
     std::vector<Variable> vars = get_variables(file);
@@ -284,7 +288,12 @@ PlanningTask PlanningTaskParser::parse_from_file(std::string filename) {
     std::vector<Action> actions = get_actions(file);
     std::vector<Axiom> axioms = get_axioms(file);
 
-    file.close();
+    if (preprocess)
+        this->preprocessor.run(metric, vars, mutexes, initial_state,
+                               goal_state, actions, axioms);
+    if (this->reorder)
+        this->reorderer.run(vars, mutexes, initial_state, goal_state, actions,
+                            axioms);
 
     return PlanningTask(metric, vars.size(), vars, mutexes.size(), mutexes,
                         initial_state, goal_state.size(), goal_state,
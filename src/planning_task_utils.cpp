@@ -4,7 +4,7 @@
 #include <iostream>
 #include <vector>
 
-void PlanningTaskUtils::print_var(Variable &var) {
+void PlanningTaskUtils::print_var(const Variable &var) {
     std::cout << var.name << std::endl;
     std::cout << var.axiom_layer << std::endl;
     std::cout << var.range << std::endl;
@@ -14,18 +14,18 @@ void PlanningTaskUtils::print_var(Variable &var) {
 }
 
 void PlanningTaskUtils::print_planning_task_vars(PlanningTask &pt) {
-    std::cout << "# Variables: " << pt.n_vars << std::endl;
-    for (int i = 0; i < pt.n_vars; i++) {
-        print_var(pt.vars[i]);
+    std::cout << "# Variables: " << pt.core->n_vars << std::endl;
+    for (int i = 0; i < pt.core->n_vars; i++) {
+        print_var(pt.core->vars[i]);
         std::cout << std::endl;
     }
 }
 
-void PlanningTaskUtils::print_fact(Fact &fact) {
+void PlanningTaskUtils::print_fact(const Fact &fact) {
     std::cout << fact.var_idx << " " << fact.var_val << std::endl;
 }
 
-void PlanningTaskUtils::print_mutex(MutexGroup &mutex) {
+void PlanningTaskUtils::print_mutex(const MutexGroup &mutex) {
     std::cout << mutex.n_facts << std::endl;
     for (int i = 0; i < mutex.n_facts; i++) {
         print_fact(mutex.facts[i]);
@@ -33,9 +33,9 @@ void PlanningTaskUtils::print_mutex(MutexGroup &mutex) {
 }
 
 void PlanningTaskUtils::print_planning_task_mutexes(PlanningTask &pt) {
-    std::cout << "# Mutexes: " << pt.n_mutex << std::endl;
-    for (int i = 0; i < pt.n_mutex; i++) {
-        print_mutex(pt.mutexes[i]);
+    std::cout << "# Mutexes: " << pt.core->n_mutex << std::endl;
+    for (int i = 0; i < pt.core->n_mutex; i++) {
+        print_mutex(pt.core->mutexes[i]);
         std::cout << std::endl;
     }
 }
@@ -55,7 +55,7 @@ void PlanningTaskUtils::print_planning_task_goal(PlanningTask &pt) {
     std::cout << std::endl;
 }
 
-void PlanningTaskUtils::print_effect(Effect &effect) {
+void PlanningTaskUtils::print_effect(const Effect &effect) {
     std::cout << effect.n_effect_conds << " ";
     for (int i = 0; i < effect.n_effect_conds; i++) {
         std::cout << effect.effect_conds[i].var_idx << " "
@@ -65,8 +65,9 @@ void PlanningTaskUtils::print_effect(Effect &effect) {
               << effect.to_value << std::endl;
 }
 
-void PlanningTaskUtils::print_action(Action &action) {
-    std::cout << action.name << std::endl;
+void PlanningTaskUtils::print_action(const Action &action,
+                                     const std::string &name) {
+    std::cout << name << std::endl;
     std::cout << action.n_preconds << std::endl;
 
     for (int i = 0; i < action.n_preconds; i++) {
@@ -82,14 +83,14 @@ void PlanningTaskUtils::print_action(Action &action) {
 }
 
 void PlanningTaskUtils::print_planning_task_actions(PlanningTask &pt) {
-    std::cout << "# Actions: " << pt.n_actions << std::endl;
-    for (int i = 0; i < pt.n_actions; i++) {
-        print_action(pt.actions[i]);
+    std::cout << "# Actions: " << pt.core->n_actions << std::endl;
+    for (int i = 0; i < pt.core->n_actions; i++) {
+        print_action(pt.core->actions[i], pt.core->action_name(i));
         std::cout << std::endl;
     }
 }
 
-void PlanningTaskUtils::print_axiom(Axiom &axiom) {
+void PlanningTaskUtils::print_axiom(const Axiom &axiom) {
     std::cout << axiom.n_conds << std::endl;
     for (int i = 0; i < axiom.n_conds; i++) {
         print_fact(axiom.conds[i]);
@@ -99,15 +100,15 @@ void PlanningTaskUtils::print_axiom(Axiom &axiom) {
 }
 
 void PlanningTaskUtils::print_planning_task_axioms(PlanningTask &pt) {
-    std::cout << "# Axioms: " << pt.n_axioms << std::endl;
-    for (int i = 0; i < pt.n_axioms; i++) {
-        print_axiom(pt.axioms[i]);
+    std::cout << "# Axioms: " << pt.core->n_axioms << std::endl;
+    for (int i = 0; i < pt.core->n_axioms; i++) {
+        print_axiom(pt.core->axioms[i]);
         std::cout << std::endl;
     }
 }
 
 void PlanningTaskUtils::print_planning_task(PlanningTask &pt) {
-    std::cout << "Metric: " << pt.metric << std::endl;
+    std::cout << "Metric: " << pt.core->metric << std::endl;
     std::cout << std::endl;
     std::cout << "Variables:" << std::endl;
     print_planning_task_vars(pt);
@@ -124,13 +125,84 @@ void PlanningTaskUtils::print_planning_task(PlanningTask &pt) {
 }
 
 void PlanningTaskUtils::print_structure(PlanningTask &pt) {
-    std::cout << "Metric: " << pt.metric << std::endl;
-    std::cout << "Variables: " << pt.n_vars << std::endl;
-    std::cout << "Mutexes: " << pt.n_mutex << std::endl;
-    std::cout << "Actions: " << pt.n_actions << std::endl;
-    std::cout << "Axioms: " << pt.n_axioms << std::endl;
+    std::cout << "Metric: " << pt.core->metric << std::endl;
+    std::cout << "Variables: " << pt.core->n_vars << std::endl;
+    std::cout << "Mutexes: " << pt.core->n_mutex << std::endl;
+    std::cout << "Actions: " << pt.core->n_actions << std::endl;
+    std::cout << "Axioms: " << pt.core->n_axioms << std::endl;
 }
 
-int PlanningTaskUtils::get_random_number(int lower, int upper) {
-    return lower + rand() % (upper - lower);
+/*
+    write the task in the translator (version 3) format read by
+    PlanningTaskParser
+*/
+void PlanningTaskUtils::write_sas(PlanningTask &pt, std::ostream &out) {
+    out << "begin_version\n3\nend_version\n";
+    out << "begin_metric\n" << pt.core->metric << "\nend_metric\n";
+
+    out << pt.core->n_vars << "\n";
+    for (int i = 0; i < pt.core->n_vars; i++) {
+        const Variable &var = pt.core->vars[i];
+        out << "begin_variable\n" << var.name << "\n" << var.axiom_layer
+            << "\n" << var.range << "\n";
+        for (int j = 0; j < var.range; j++) out << var.sym_names[j] << "\n";
+        out << "end_variable\n";
+    }
+
+    out << pt.core->n_mutex << "\n";
+    for (int i = 0; i < pt.core->n_mutex; i++) {
+        const MutexGroup &mutex = pt.core->mutexes[i];
+        out << "begin_mutex_group\n" << mutex.n_facts << "\n";
+        for (int j = 0; j < mutex.n_facts; j++)
+            out << mutex.facts[j].var_idx << " " << mutex.facts[j].var_val
+                << "\n";
+        out << "end_mutex_group\n";
+    }
+
+    out << "begin_state\n";
+    for (int i = 0; i < pt.initial_state.size(); i++)
+        out << pt.initial_state[i] << "\n";
+    out << "end_state\n";
+
+    out << "begin_goal\n" << pt.n_goals << "\n";
+    for (int i = 0; i < pt.n_goals; i++)
+        out << pt.goal_state[i].var_idx << " " << pt.goal_state[i].var_val
+            << "\n";
+    out << "end_goal\n";
+
+    out << pt.core->n_actions << "\n";
+    for (int i = 0; i < pt.core->n_actions; i++) {
+        const Action &action = pt.core->actions[i];
+        out << "begin_operator\n" << pt.core->action_name(i) << "\n"
+            << action.n_preconds << "\n";
+        for (int j = 0; j < action.n_preconds; j++)
+            out << action.preconds[j].var_idx << " "
+                << action.preconds[j].var_val << "\n";
+        out << action.n_effects << "\n";
+        for (int j = 0; j < action.n_effects; j++) {
+            const Effect &effect = action.effects[j];
+            out << effect.n_effect_conds;
+            for (int k = 0; k < effect.n_effect_conds; k++)
+                out << " " << effect.effect_conds[k].var_idx << " "
+                    << effect.effect_conds[k].var_val;
+            out << " " << effect.var_affected << " " << effect.from_value
+                << " " << effect.to_value << "\n";
+        }
+        out << action.cost << "\nend_operator\n";
+    }
+
+    out << pt.core->n_axioms << "\n";
+    for (int i = 0; i < pt.core->n_axioms; i++) {
+        const Axiom &axiom = pt.core->axioms[i];
+        out << "begin_rule\n" << axiom.n_conds << "\n";
+        for (int j = 0; j < axiom.n_conds; j++)
+            out << axiom.conds[j].var_idx << " " << axiom.conds[j].var_val
+                << "\n";
+        out << axiom.affected_var << " " << axiom.from_value << " "
+            << axiom.to_value << "\nend_rule\n";
+    }
+}
+
+int PlanningTaskUtils::get_random_number(Rng &rng, int lower, int upper) {
+    return lower + rng.below(upper - lower);
 }
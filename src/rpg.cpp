@@ -0,0 +1,262 @@
+#include "../include/rpg.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+/*
+    added = next & ~layer, layer = next; returns true if something was added
+*/
+static bool advance_layer(uint64_t *layer, const uint64_t *next,
+                          uint64_t *added, int n_words) {
+    int i = 0;
+    bool any = false;
+#ifdef __AVX2__
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 4 <= n_words; i += 4) {
+        __m256i cur = _mm256_loadu_si256((const __m256i *)(layer + i));
+        __m256i nxt = _mm256_loadu_si256((const __m256i *)(next + i));
+        __m256i diff = _mm256_andnot_si256(cur, nxt);
+        _mm256_storeu_si256((__m256i *)(added + i), diff);
+        _mm256_storeu_si256((__m256i *)(layer + i), nxt);
+        acc = _mm256_or_si256(acc, diff);
+    }
+    any = !_mm256_testz_si256(acc, acc);
+#endif
+    for (; i < n_words; i++) {
+        added[i] = next[i] & ~layer[i];
+        layer[i] = next[i];
+        any |= added[i] != 0;
+    }
+    return any;
+}
+
+const int RelaxedPlanningGraph::unreachable;
+const int RelaxedPlanningGraph::batch_size;
+
+RelaxedPlanningGraph::RelaxedPlanningGraph(const TaskCore &core) {
+    this->core = &core;
+    this->n_words = (core.n_facts + 63) / 64;
+    this->n_layers = 0;
+
+    const OperatorTable &ops = core.ops;
+    this->mask_begin.push_back(0);
+    for (int a = 0; a < core.n_actions; a++) {
+        std::vector<int> ids(
+            ops.precond_ids.begin() + ops.precond_start[a],
+            ops.precond_ids.begin() + ops.precond_start[a + 1]);
+        std::sort(ids.begin(), ids.end());
+        for (int id : ids) {
+            if (id == -1) continue;
+            uint64_t bit = uint64_t(1) << (id & 63);
+            if (this->mask_word.size() > this->mask_begin.back() &&
+                this->mask_word.back() == (id >> 6)) {
+                this->mask_bits.back() |= bit;
+            } else {
+                this->mask_word.push_back(id >> 6);
+                this->mask_bits.push_back(bit);
+            }
+        }
+        this->mask_begin.push_back(this->mask_word.size());
+    }
+
+    // the added facts are the effects of the operator table
+    this->add_fact = ops.effect_to;
+    this->add_begin = ops.effect_start;
+
+    this->pre_begin.push_back(0);
+    for (int a = 0; a < core.n_actions; a++) {
+        for (int j = ops.precond_start[a]; j < ops.precond_start[a + 1]; j++)
+            if (ops.precond_ids[j] != -1)
+                this->pre_fact.push_back(ops.precond_ids[j]);
+        this->pre_begin.push_back(this->pre_fact.size());
+    }
+
+    this->candidate_stamp.assign(core.n_actions, -1);
+}
+
+bool RelaxedPlanningGraph::applicable(int action) {
+    for (int i = this->mask_begin[action]; i < this->mask_begin[action + 1];
+         i++)
+        if ((this->layer[this->mask_word[i]] & this->mask_bits[i]) !=
+            this->mask_bits[i])
+            return false;
+    return true;
+}
+
+void RelaxedPlanningGraph::build(const State &state,
+                                 const std::vector<char> &is_used,
+                                 const std::vector<int> &goals) {
+    const TaskCore &core = *this->core;
+    this->fact_level.assign(core.n_facts, unreachable);
+    this->action_level.assign(core.n_actions, unreachable);
+    this->layer = state.words;
+    this->next_layer = state.words;
+    this->added.assign(this->n_words, 0);
+    std::fill(this->candidate_stamp.begin(), this->candidate_stamp.end(), -1);
+
+    for (int f = 0; f < core.n_facts; f++)
+        if (state.has(f)) this->fact_level[f] = 0;
+
+    // every action is tested on the first layer
+    this->candidates.clear();
+    for (int a = 0; a < core.n_actions; a++)
+        if (!is_used[a]) this->candidates.push_back(a);
+
+    int n_goals_left = 0;
+    for (int goal : goals)
+        if (!state.has(goal)) n_goals_left++;
+
+    int k = 0;
+    while (goals.empty() || n_goals_left > 0) {
+        for (int a : this->candidates) {
+            if (this->action_level[a] != unreachable || !applicable(a))
+                continue;
+            this->action_level[a] = k;
+            for (int i = this->add_begin[a]; i < this->add_begin[a + 1]; i++) {
+                int f = this->add_fact[i];
+                this->next_layer[f >> 6] |= uint64_t(1) << (f & 63);
+            }
+        }
+
+        if (!advance_layer(this->layer.data(), this->next_layer.data(),
+                           this->added.data(), this->n_words))
+            break;
+        k++;
+
+        for (int goal : goals)
+            if ((this->added[goal >> 6] >> (goal & 63)) & 1) n_goals_left--;
+
+        // the next candidates need one of the facts just added
+        this->candidates.clear();
+        for (int w = 0; w < this->n_words; w++) {
+            for (uint64_t bits = this->added[w]; bits; bits &= bits - 1) {
+                int f = w * 64 + __builtin_ctzll(bits);
+                this->fact_level[f] = k;
+                for (int a : core.precond_actions[f]) {
+                    if (is_used[a] || this->candidate_stamp[a] == k) continue;
+                    this->candidate_stamp[a] = k;
+                    this->candidates.push_back(a);
+                }
+            }
+        }
+    }
+    this->n_layers = k + 1;
+}
+
+void RelaxedPlanningGraph::backward_cone(const State &state,
+                                         const std::vector<char> &is_used,
+                                         const std::vector<int> &goals,
+                                         std::vector<int> &actions) {
+    const TaskCore &core = *this->core;
+    this->visited_facts = state.words;  // true facts are never expanded
+    this->visited_actions.assign(core.n_actions, 0);
+    this->stack.clear();
+    actions.clear();
+
+    auto visit = [&](int f) {
+        uint64_t bit = uint64_t(1) << (f & 63);
+        if (this->visited_facts[f >> 6] & bit) return;
+        this->visited_facts[f >> 6] |= bit;
+        this->stack.push_back(f);
+    };
+    for (int goal : goals) visit(goal);
+
+    while (!this->stack.empty()) {
+        int fact = this->stack.back();
+        this->stack.pop_back();
+        for (int a : core.effect_actions[fact]) {
+            if (is_used[a] || this->visited_actions[a]) continue;
+            this->visited_actions[a] = 1;
+            actions.push_back(a);
+            for (int i = this->mask_begin[a]; i < this->mask_begin[a + 1];
+                 i++)
+                for (uint64_t bits = this->mask_bits[i]; bits;
+                     bits &= bits - 1)
+                    visit(this->mask_word[i] * 64 + __builtin_ctzll(bits));
+        }
+    }
+}
+
+void RelaxedPlanningGraph::evaluate_batch(const State *states, int n_states,
+                                          const std::vector<char> &is_used,
+                                          const std::vector<int> &goals,
+                                          int *totals) {
+    const TaskCore &core = *this->core;
+    uint64_t all = n_states == 64 ? ~uint64_t(0)
+                                  : (uint64_t(1) << n_states) - 1;
+    this->fact_lanes.assign(core.n_facts, 0);
+    this->pending_lanes.assign(core.n_facts, 0);
+    this->action_lanes.assign(core.n_actions, 0);
+    std::fill(this->candidate_stamp.begin(), this->candidate_stamp.end(), -1);
+
+    for (int s = 0; s < n_states; s++) {
+        const std::vector<uint64_t> &words = states[s].words;
+        for (int w = 0; w < this->n_words; w++)
+            for (uint64_t bits = words[w]; bits; bits &= bits - 1)
+                this->fact_lanes[w * 64 + __builtin_ctzll(bits)] |=
+                    uint64_t(1) << s;
+    }
+
+    auto goal_lanes = [&]() {
+        uint64_t lanes = all;
+        for (int goal : goals) lanes &= this->fact_lanes[goal];
+        return lanes;
+    };
+    uint64_t done = goal_lanes();
+    for (int s = 0; s < n_states; s++)
+        totals[s] = std::numeric_limits<int>::max();
+    for (uint64_t bits = done; bits; bits &= bits - 1)
+        totals[__builtin_ctzll(bits)] = 0;
+
+    this->candidates.clear();
+    for (int a = 0; a < core.n_actions; a++)
+        if (!is_used[a]) this->candidates.push_back(a);
+
+    int k = 0;
+    while (done != all) {
+        // effects reach the next layer: collect them in pending_lanes first
+        this->touched.clear();
+        for (int a : this->candidates) {
+            uint64_t lanes = all & ~this->action_lanes[a];
+            int end = this->pre_begin[a + 1];
+            for (int i = this->pre_begin[a]; lanes && i < end; i++)
+                lanes &= this->fact_lanes[this->pre_fact[i]];
+            if (!lanes) continue;
+            this->action_lanes[a] |= lanes;
+            for (int i = this->add_begin[a]; i < this->add_begin[a + 1]; i++) {
+                int f = this->add_fact[i];
+                if (!this->pending_lanes[f]) this->touched.push_back(f);
+                this->pending_lanes[f] |= lanes;
+            }
+        }
+
+        this->changed.clear();
+        for (int f : this->touched) {
+            uint64_t added = this->pending_lanes[f] & ~this->fact_lanes[f];
+            this->pending_lanes[f] = 0;
+            if (!added) continue;
+            this->fact_lanes[f] |= added;
+            this->changed.push_back(f);
+        }
+        if (this->changed.empty()) break;
+        k++;
+
+        uint64_t now = goal_lanes();
+        for (uint64_t bits = now & ~done; bits; bits &= bits - 1)
+            totals[__builtin_ctzll(bits)] = k;
+        done = now;
+
+        this->candidates.clear();
+        for (int f : this->changed)
+            for (int a : core.precond_actions[f]) {
+                if (is_used[a] || this->candidate_stamp[a] == k) continue;
+                this->candidate_stamp[a] = k;
+                this->candidates.push_back(a);
+            }
+    }
+}
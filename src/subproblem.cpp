@@ -0,0 +1,487 @@
+#include "../include/subproblem.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <ostream>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "../include/memory_budget.h"
+#include "../include/plan_validator.h"
+
+void compute_next_state(PlanningTask &pt, int action_idx,
+                        std::vector<int> &current_state) {
+    const TaskCore &core = *pt.core;
+    const OperatorTable &ops = core.ops;
+    auto holds = [&](int fact) {
+        return fact == -1 ||
+               current_state[core.facts[fact].var_idx] ==
+                   core.facts[fact].var_val;
+    };
+    for (int e = ops.effect_start[action_idx];
+         e < ops.effect_start[action_idx + 1]; e++) {
+        int k;
+        for (k = ops.cond_start[e]; k < ops.cond_start[e + 1]; k++)
+            if (!holds(ops.cond_ids[k])) break;
+        if (k < ops.cond_start[e + 1] || !holds(ops.effect_from[e])) {
+            pt.pending_effects.push_back(e);  // the effect cannot be applied
+            continue;
+        }
+        const Fact &to = core.facts[ops.effect_to[e]];
+        current_state[to.var_idx] = to.var_val;
+    }
+}
+
+/*
+    sub.solution becomes original.solution[0, start) + sub.solution +
+    original.solution[end, size), built in a single pass
+*/
+void merge_solutions(int start, int end, PlanningTask &original,
+                     PlanningTask &sub) {
+    std::vector<int> merged;
+    merged.reserve(original.solution.size() - (end - start) +
+                   sub.solution.size());
+    merged.insert(merged.end(), original.solution.begin(),
+                  original.solution.begin() + start);
+    merged.insert(merged.end(), sub.solution.begin(), sub.solution.end());
+    merged.insert(merged.end(), original.solution.begin() + end,
+                  original.solution.end());
+
+    for (int i = 0; i < original.solution.size(); i++) {
+        if (i >= start && i < end) continue;  // replaced by sub.solution
+        int idx = original.solution[i];
+        sub.solution_cost +=
+            (sub.core->metric == 1) ? original.core->ops.cost[idx] : 1;
+        sub.mark_used(idx);  // mark them as used
+    }
+    sub.solution.swap(merged);
+}
+
+PlanningTask create_subproblem(PlanningTask &orig, int start, int end) {
+    PlanningTask sub(orig);
+    std::vector<int> current_state = orig.initial_state;
+
+    // new initial_state = state after applying action at start
+    int i = 0;
+    for (; i < end; i++) {
+        if (i == start) sub.initial_state = current_state;
+        int idx = orig.solution[i];
+        compute_next_state(sub, idx, current_state);
+    }
+
+    // new goal_state = goal state facts up to end + preconditions of following
+    // actions
+    const TaskCore &core = *orig.core;
+    std::unordered_set<int> required_vars;
+    for (int j = end; j < orig.solution.size(); ++j) {
+        int a = orig.solution[j];
+        for (int k = core.ops.precond_start[a];
+             k < core.ops.precond_start[a + 1]; k++)
+            required_vars.insert(core.facts[core.ops.precond_ids[k]].var_idx);
+    }
+    for (const Fact &goal_fact : orig.goal_state) {
+        required_vars.insert(goal_fact.var_idx);
+    }
+
+    for (int k = 0; k < current_state.size(); ++k)
+        if (sub.initial_state[k] != current_state[k] &&
+            required_vars.count(k))  // add only facts that are not already
+                                     // present in the initial state
+            sub.goal_state.push_back({k, current_state[k]});
+
+    sub.n_goals = sub.goal_state.size();
+    return sub;
+}
+
+/*
+    Backward cone of the goals of a window: the facts needed that are not
+    true at its start (the goals, then the preconditions, effect conditions
+    and from values of their achievers, and the conditions of the axioms
+    deriving them) and the actions adding one of them. No other action can
+    be part of a plan of the window
+*/
+class GoalCone {
+   public:
+    const TaskCore &core;
+    std::vector<std::vector<int>> axioms_of;  // fact id -> axioms adding it
+    std::vector<char> needed;                 // per fact
+    std::vector<char> relevant;               // per action
+    std::vector<int> stack;
+
+    GoalCone(const TaskCore &core)
+        : core(core),
+          axioms_of(core.n_facts),
+          needed(core.n_facts),
+          relevant(core.n_actions) {
+        for (int x = 0; x < core.n_axioms; x++)
+            axioms_of[core.axioms[x].to_id].push_back(x);
+    }
+
+    void compute(const State &start, const std::vector<Fact> &goals) {
+        const OperatorTable &ops = this->core.ops;
+        std::fill(this->needed.begin(), this->needed.end(), 0);
+        std::fill(this->relevant.begin(), this->relevant.end(), 0);
+        auto need = [&](int f) {
+            if (f == -1 || start.has(f) || this->needed[f]) return;
+            this->needed[f] = 1;
+            this->stack.push_back(f);
+        };
+        for (const Fact &goal : goals) need(this->core.fact_id(goal));
+        while (!this->stack.empty()) {
+            int f = this->stack.back();
+            this->stack.pop_back();
+            for (int a : this->core.effect_actions[f]) {
+                for (int e = ops.effect_start[a]; e < ops.effect_start[a + 1];
+                     e++) {
+                    if (ops.effect_to[e] != f) continue;
+                    need(ops.effect_from[e]);
+                    for (int k = ops.cond_start[e]; k < ops.cond_start[e + 1];
+                         k++)
+                        need(ops.cond_ids[k]);
+                }
+                if (this->relevant[a]) continue;
+                this->relevant[a] = 1;
+                for (int k = ops.precond_start[a];
+                     k < ops.precond_start[a + 1]; k++)
+                    need(ops.precond_ids[k]);
+            }
+            for (int x : this->axioms_of[f]) {
+                const Axiom &axiom = this->core.axioms[x];
+                need(axiom.from_id);
+                for (int cond : axiom.cond_ids) need(cond);
+            }
+        }
+    }
+};
+
+static void set_facts(const TaskCore &core, const std::vector<int> &values,
+                      State &facts) {
+    std::fill(facts.words.begin(), facts.words.end(), 0);
+    for (int var = 0; var < core.n_vars; var++)
+        facts.add(core.fact_id(var, values[var]));
+}
+
+/*
+    states generated by the ucs of a window costing cost, from the b actions
+    of the cone applicable at its start: every subset of them is taken as a
+    state (n_subsets[c] counts those costing c), the ones costing less than
+    the window and half of those costing as much are expanded, and each
+    expansion generates b states. Stops counting above limit
+*/
+static double predict_nodes(const TaskCore &core, const GoalCone &cone,
+                            const State &start, int cost, double limit,
+                            std::vector<int> &applicable,
+                            std::vector<double> &n_subsets) {
+    const OperatorTable &ops = core.ops;
+    applicable.clear();
+    for (int a = 0; a < core.n_actions; a++) {
+        if (!cone.relevant[a]) continue;
+        int k;
+        for (k = ops.precond_start[a]; k < ops.precond_start[a + 1]; k++)
+            if (!start.has(ops.precond_ids[k])) break;
+        if (k == ops.precond_start[a + 1]) applicable.push_back(a);
+    }
+    int b = applicable.size();
+
+    n_subsets.assign(cost + 1, 0);
+    n_subsets[0] = 1;
+    double expanded = 1;
+    int reach = 0;  // cost of the most expensive subset so far
+    for (int a : applicable) {
+        if (expanded * b > limit) break;
+        int w = core.metric == 1 ? std::max(ops.cost[a], 1) : 1;
+        reach = std::min(reach + w, cost);
+        for (int c = reach; c >= w; c--) {
+            double more = n_subsets[c - w];
+            n_subsets[c] += more;
+            expanded += c < cost ? more : more / 2;
+        }
+    }
+    return expanded * b;
+}
+
+std::vector<Window> select_windows(PlanningTask &pt, double node_budget) {
+    const TaskCore &core = *pt.core;
+    const OperatorTable &ops = core.ops;
+    int n = pt.solution.size();
+    int inf = std::numeric_limits<int>::max();
+
+    // the goals of a window are the variables it changes that a later step
+    // or the goal needs: last_needed[var] is the last step with a
+    // precondition on var, n for the goal variables
+    std::vector<int> last_needed(core.n_vars, -1);
+    for (int i = 0; i < n; i++) {
+        int a = pt.solution[i];
+        for (int k = ops.precond_start[a]; k < ops.precond_start[a + 1]; k++)
+            last_needed[core.facts[ops.precond_ids[k]].var_idx] = i;
+    }
+    for (const Fact &goal : pt.goal_state) last_needed[goal.var_idx] = n;
+    auto step_cost = [&](int i) {
+        return core.metric == 1 ? ops.cost[pt.solution[i]] : 1;
+    };
+
+    // a single replay of the plan, as create_subproblem does it: sub is the
+    // subproblem of the window being grown (with the pending effects of the
+    // replay so far), values the state at the end of the window
+    PlanningTask sub(pt);
+    std::vector<int> values = pt.initial_state, next;
+    std::vector<Fact> goals;
+    auto set_goals = [&](int end, const std::vector<int> &at_end,
+                         std::vector<Fact> &window_goals) {
+        window_goals.clear();
+        for (int var = 0; var < core.n_vars; var++)
+            if (at_end[var] != sub.initial_state[var] &&
+                last_needed[var] >= end)
+                window_goals.push_back({var, at_end[var]});
+    };
+    State start_facts(core.n_facts);
+    GoalCone cone(core);
+    std::vector<int> applicable;
+    std::vector<double> n_subsets;
+
+    std::vector<Window> windows;
+    for (int start = 0, end; start < n; start = end) {
+        Window w;
+        w.start = start;
+        sub.initial_state = values;
+        set_facts(core, values, start_facts);
+
+        // the first step is always taken, the next ones while the ucs fits
+        compute_next_state(sub, pt.solution[start], values);
+        end = start + 1;
+        w.cost = step_cost(start);
+        set_goals(end, values, w.goal_state);
+        cone.compute(start_facts, w.goal_state);
+        w.predicted_nodes = predict_nodes(core, cone, start_facts, w.cost,
+                                          node_budget, applicable, n_subsets);
+        while (end < n && w.predicted_nodes <= node_budget) {
+            int n_pending = sub.pending_effects.size();
+            next = values;
+            compute_next_state(sub, pt.solution[end], next);
+            set_goals(end + 1, next, goals);
+            cone.compute(start_facts, goals);
+            int cost = w.cost + step_cost(end);
+            double predicted = predict_nodes(core, cone, start_facts, cost,
+                                             node_budget, applicable,
+                                             n_subsets);
+            if (predicted > node_budget) {
+                sub.pending_effects.resize(n_pending);
+                break;
+            }
+            values.swap(next);
+            w.goal_state.swap(goals);
+            w.cost = cost;
+            w.predicted_nodes = predicted;
+            end++;
+        }
+        w.end = end;
+        if (w.predicted_nodes > node_budget) continue;
+
+        // INT_MAX: h_max finds no way to the goals (it does not derive
+        // axioms), which is left to the search
+        sub.goal_state = w.goal_state;
+        sub.n_goals = sub.goal_state.size();
+        w.lower_bound = sub.lower_bound();
+        if (w.lower_bound == inf) w.lower_bound = -1;
+        if (w.lower_bound >= w.cost) continue;
+        w.initial_state = sub.initial_state;
+        w.pending_effects = sub.pending_effects;
+        windows.push_back(w);
+    }
+
+    // an unknown bound counts as 0
+    auto slack = [](const Window &w) {
+        return w.cost - std::max(w.lower_bound, 0);
+    };
+    std::stable_sort(windows.begin(), windows.end(),
+                     [&](const Window &a, const Window &b) {
+                         return slack(a) > slack(b);
+                     });
+    return windows;
+}
+
+// messages of the re-optimisation go to pt.log, if any
+static const char *solution_header = "############### Solution ###############";
+
+static bool ucs_out_of_memory(PlanningTask &pt) {
+    return pt.memory && pt.memory->limit_reached;
+}
+
+static int deadline_passed(PlanningTask &pt, std::ostream &out) {
+    out << "Timelimit reached" << std::endl;
+    out << std::endl << solution_header << std::endl;
+    pt.print_solution(out);
+    return -2;
+}
+
+int reoptimise_window(PlanningTask &pt, PlanningTask &sub, int alg, int seed,
+                      bool debug, float p_start, float p_end,
+                      const std::function<void()> &on_improved) {
+    std::ostream nowhere(nullptr);
+    std::ostream &out = pt.log ? *pt.log : nowhere;
+
+    int start = pt.solution.size() * p_start;
+    int end = pt.solution.size() * p_end;
+    if (start >= end) {
+        out << std::endl << "Degenerate subproblem: start >= end" << std::endl;
+        out << "Returning original solution" << std::endl;
+        out << std::endl << solution_header << std::endl;
+        pt.print_solution(out);
+        return 1;
+    }
+
+    out << std::endl << "Solving subproblem..." << std::endl;
+    sub = create_subproblem(pt, start, end);
+
+    int section_cost = 0;
+    for (int i = start; i < end; i++) {
+        section_cost += pt.core->ops.cost[pt.solution[i]];
+    }
+    out << "Original subproblem cost: " << section_cost << std::endl;
+
+    int res_sub;
+    if (alg == 7)
+        res_sub = sub.solve(seed, 4, debug);
+    else
+        res_sub = sub.ucs();
+    if (res_sub == -2) return deadline_passed(pt, out);
+
+    if (!res_sub) {
+        out << std::endl
+            << "############### Sub-Problem Solution ###############"
+            << std::endl;
+        sub.print_solution(out);
+
+        // merge sub-solution with the original one
+        merge_solutions(start, end, pt, sub);
+        bool improved = sub.solution_cost < pt.solution_cost;
+        if (improved) {
+            out << "Improved solution found!" << std::endl;
+            out << std::endl << solution_header << std::endl;
+            sub.print_solution(out);
+        } else {
+            out << "No improvements. Returning original solution"
+                << std::endl;
+            out << std::endl << solution_header << std::endl;
+            pt.print_solution(out);
+        }
+
+        if (debug) {
+            sub.initial_state = pt.initial_state;
+            sub.goal_state = pt.goal_state;
+            std::string error;
+            if (sub.check_integrity(&error))
+                out << "Integrity check passed!" << std::endl;
+            else
+                out << "Integrity check NOT passed! " << error << std::endl;
+        }
+        if (improved) {
+            pt.solution = sub.solution;
+            pt.solution_cost = sub.solution_cost;
+            if (on_improved) on_improved();
+        }
+    }
+    if (res_sub && alg == 8) {
+        out << (ucs_out_of_memory(pt) ? "UCS: memory limit reached"
+                                      : "UCS: too many nodes")
+            << ". Returning original solution" << std::endl;
+        out << std::endl << solution_header << std::endl;
+        pt.print_solution(out);
+    }
+    return 0;
+}
+
+int reoptimise_windows(PlanningTask &pt, PlanningTask &sub, int alg,
+                       int seed, bool debug,
+                       const std::function<void()> &on_improved) {
+    std::ostream nowhere(nullptr);
+    std::ostream &out = pt.log ? *pt.log : nowhere;
+
+    std::vector<Window> windows =
+        select_windows(pt, PlanningTask::ucs_max_states);
+    out << std::endl << "Windows to re-optimise: " << windows.size()
+        << std::endl;
+
+    // start and change in length of the improved windows: the later windows
+    // move by that much
+    std::vector<std::pair<int, int>> shifts;
+    PlanValidator validator(*pt.core);
+    const TaskCore &core = *pt.core;
+    GoalCone cone(core);
+    State start_facts(core.n_facts);
+    for (const Window &w : windows) {
+        int start = w.start, end = w.end;
+        for (const std::pair<int, int> &shift : shifts) {
+            if (shift.first >= w.start) continue;
+            start += shift.second;
+            end += shift.second;
+        }
+        out << std::endl
+            << "Solving window [" << start << ", " << end << "): cost "
+            << w.cost << ", lower bound ";
+        if (w.lower_bound == -1)
+            out << "unknown";
+        else
+            out << w.lower_bound;
+        out << ", predicted nodes " << w.predicted_nodes << std::endl;
+
+        if (shifts.empty()) {
+            // the plan is still the one select_windows replayed
+            sub = PlanningTask(pt);
+            sub.initial_state = w.initial_state;
+            sub.goal_state = w.goal_state;
+            sub.n_goals = sub.goal_state.size();
+            sub.pending_effects = w.pending_effects;
+        } else {
+            sub = create_subproblem(pt, start, end);
+        }
+        if (alg == 8) {
+            // only the actions of the cone, as predicted
+            set_facts(core, sub.initial_state, start_facts);
+            cone.compute(start_facts, sub.goal_state);
+            for (int a = 0; a < core.n_actions; a++)
+                if (!cone.relevant[a]) sub.is_used[a] = true;
+        }
+        int res_sub = alg == 7 ? sub.solve(seed, 4, debug) : sub.ucs();
+        if (res_sub == -2) return deadline_passed(pt, out);
+        if (res_sub) {
+            if (res_sub == -1 && alg == 8)
+                out << (ucs_out_of_memory(pt) ? "UCS: memory limit reached"
+                                              : "UCS: too many nodes")
+                    << std::endl;
+            continue;
+        }
+
+        int sub_length = sub.solution.size();
+        merge_solutions(start, end, pt, sub);
+        if (sub.solution_cost >= pt.solution_cost) {
+            out << "No improvements" << std::endl;
+        } else if (!validator.validate(pt.initial_state, pt.goal_state,
+                                       sub.solution, sub.solution_cost)) {
+            // the improvements are chained: never keep a broken plan
+            out << "Merged solution NOT valid, discarded: step "
+                << validator.failed_step << ": " << validator.error
+                << std::endl;
+        } else {
+            out << "Improved solution found! Cost: " << sub.solution_cost
+                << std::endl;
+            shifts.push_back({w.start, sub_length - (end - start)});
+            pt.solution = sub.solution;
+            pt.solution_cost = sub.solution_cost;
+            if (on_improved) on_improved();
+        }
+    }
+
+    out << std::endl << solution_header << std::endl;
+    pt.print_solution(out);
+    if (debug) {
+        std::string error;
+        if (pt.check_integrity(&error))
+            out << "Integrity check passed!" << std::endl;
+        else
+            out << "Integrity check NOT passed! " << error << std::endl;
+    }
+    return 0;
+}
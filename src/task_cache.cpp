@@ -0,0 +1,61 @@
+#include "../include/task_cache.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+TaskCache::TaskCache(size_t capacity) { this->capacity = capacity; }
+
+uint64_t TaskCache::hash(const std::string &bytes) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : bytes) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+std::shared_ptr<const Planner> TaskCache::get(const std::string &file_name,
+                                              int preprocess, bool reorder,
+                                              bool &hit) {
+    std::ifstream file(file_name);
+    if (!file.is_open()) throw std::runtime_error("Failed to open the file");
+    std::stringstream bytes;
+    bytes << file.rdbuf();
+    std::string sas = bytes.str();
+    std::string key = std::to_string(hash(sas)) + "/" +
+                      std::to_string(preprocess) + (reorder ? "r" : "");
+
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->index.find(key);
+        if (it != this->index.end()) {
+            this->entries.splice(this->entries.begin(), this->entries,
+                                 it->second);
+            this->n_hits++;
+            hit = true;
+            return it->second->second;
+        }
+    }
+
+    // parsed without the lock: other requests go on meanwhile (two misses on
+    // the same task both parse it, the second one is dropped)
+    std::shared_ptr<Planner> planner = std::make_shared<Planner>();
+    planner->load_string(sas, preprocess, reorder);
+    if (this->heuristic_cache_bytes)
+        planner->enable_heuristic_cache(this->heuristic_cache_bytes);
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    hit = false;
+    this->n_misses++;
+    auto it = this->index.find(key);
+    if (it != this->index.end()) return it->second->second;
+    this->entries.emplace_front(key, planner);
+    this->index[key] = this->entries.begin();
+    while (this->entries.size() > this->capacity) {
+        this->index.erase(this->entries.back().first);
+        this->entries.pop_back();
+    }
+    return planner;
+}
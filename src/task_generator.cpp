@@ -0,0 +1,302 @@
+#include "../include/task_generator.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+int TaskGenerator::random_int(int lower, int upper) {
+    return std::uniform_int_distribution<int>(lower, upper)(this->gen);
+}
+
+void TaskGenerator::reach(Fact fact) {
+    if (this->reached[fact.var_idx][fact.var_val]) return;
+    this->reached[fact.var_idx][fact.var_val] = true;
+    this->reached_facts.push_back(fact);
+}
+
+/*
+    sample up to n reached facts on pairwise different variables
+*/
+std::vector<Fact> TaskGenerator::sample_reached_facts(int n) {
+    std::vector<Fact> facts;
+    for (int tries = 0; facts.size() < n && tries < 4 * n; tries++) {
+        Fact f = this->reached_facts[random_int(
+            0, this->reached_facts.size() - 1)];
+        bool same_var = false;
+        for (Fact &other : facts)
+            if (other.var_idx == f.var_idx) same_var = true;
+        if (!same_var) facts.push_back(f);
+    }
+    return facts;
+}
+
+int TaskGenerator::sample_cost(const TaskGeneratorParams &params) {
+    switch (params.cost_distribution) {
+        case CostDistribution::unit:
+            return 1;
+        case CostDistribution::uniform:
+            return random_int(params.min_cost, params.max_cost);
+        case CostDistribution::bimodal:
+            if (random_int(0, 9) == 0)
+                return 10 * random_int(params.min_cost, params.max_cost);
+            return random_int(params.min_cost, params.max_cost);
+    }
+    return 1;
+}
+
+Action TaskGenerator::generate_action(int i,
+                                      const TaskGeneratorParams &params) {
+    Action action;
+    action.name = "op" + std::to_string(i);
+    action.original_idx = i;
+
+    action.preconds = sample_reached_facts(
+        random_int(params.min_preconds, params.max_preconds));
+    action.n_preconds = action.preconds.size();
+
+    // effects only touch regular variables, each at most once
+    std::vector<int> targets;
+    int n_effects = random_int(1, params.max_effects);
+    for (int tries = 0; targets.size() < n_effects && tries < 4 * n_effects;
+         tries++) {
+        int var = random_int(0, params.n_vars - 1);
+        if (std::find(targets.begin(), targets.end(), var) == targets.end())
+            targets.push_back(var);
+    }
+
+    std::vector<Fact> produced;
+    for (int var : targets) {
+        Effect effect;
+        if (std::uniform_real_distribution<double>(0, 1)(this->gen) <
+            params.cond_effect_prob)
+            effect.effect_conds =
+                sample_reached_facts(random_int(1, params.max_effect_conds));
+        effect.n_effect_conds = effect.effect_conds.size();
+
+        // prefer a value nobody produces yet, so the task keeps growing
+        std::vector<int> new_values;
+        for (int val = 1; val < this->vars[var].range; val++)
+            if (!this->reached[var][val]) new_values.push_back(val);
+        effect.var_affected = var;
+        effect.from_value = random_int(0, 1) ? -1 : 0;
+        effect.to_value =
+            new_values.empty()
+                ? random_int(1, this->vars[var].range - 1)
+                : new_values[random_int(0, new_values.size() - 1)];
+        action.effects.push_back(effect);
+        produced.push_back({var, effect.to_value});
+
+        action.name += " v" + std::to_string(var);
+    }
+    action.n_effects = action.effects.size();
+    action.cost = sample_cost(params);
+
+    // effects become available only to the following actions
+    for (Fact &f : produced) {
+        if (!this->reached[f.var_idx][f.var_val])
+            this->producer[f.var_idx][f.var_val] = i;
+        reach(f);
+    }
+    return action;
+}
+
+/*
+    every derived variable of the layer is set by a few axioms whose
+    conditions are facts reached so far (possibly derived at lower layers)
+*/
+std::vector<Axiom> TaskGenerator::generate_axiom_layer(
+    int layer, const TaskGeneratorParams &params) {
+    std::vector<Axiom> axioms;
+    int first = params.n_vars + layer * params.derived_per_layer;
+    for (int var = first; var < first + params.derived_per_layer; var++) {
+        for (int i = 0; i < params.axioms_per_derived; i++) {
+            Axiom axiom;
+            axiom.conds = sample_reached_facts(random_int(1, 2));
+            axiom.n_conds = axiom.conds.size();
+            axiom.affected_var = var;
+            axiom.from_value = 0;
+            axiom.to_value = 1;
+            axioms.push_back(axiom);
+        }
+    }
+    for (int var = first; var < first + params.derived_per_layer; var++)
+        reach({var, 1});
+    return axioms;
+}
+
+/*
+    facts the plan in creation order needs for the goals: the goals, and
+    recursively the preconditions and the effect conditions of their first
+    producer, or the conditions of the first axiom of a derived goal
+*/
+std::vector<std::vector<bool>> TaskGenerator::plan_facts(
+    const std::vector<Fact> &goal_state, const std::vector<Action> &actions,
+    const std::vector<Axiom> &axioms) {
+    std::vector<std::vector<bool>> needed;
+    for (const Variable &var : this->vars)
+        needed.push_back(std::vector<bool>(var.range, false));
+    std::vector<Fact> open = goal_state;
+    while (!open.empty()) {
+        Fact f = open.back();
+        open.pop_back();
+        if (needed[f.var_idx][f.var_val]) continue;
+        needed[f.var_idx][f.var_val] = true;
+        int p = this->producer[f.var_idx][f.var_val];
+        if (p != -1) {
+            const Action &action = actions[p];
+            open.insert(open.end(), action.preconds.begin(),
+                        action.preconds.end());
+            for (const Effect &effect : action.effects)
+                if (effect.var_affected == f.var_idx &&
+                    effect.to_value == f.var_val)
+                    open.insert(open.end(), effect.effect_conds.begin(),
+                                effect.effect_conds.end());
+        } else if (this->vars[f.var_idx].axiom_layer != -1) {
+            for (const Axiom &axiom : axioms) {
+                if (axiom.affected_var != f.var_idx) continue;
+                open.insert(open.end(), axiom.conds.begin(), axiom.conds.end());
+                break;
+            }
+        }
+    }
+    return needed;
+}
+
+/*
+    groups of up to mutex_size produced facts off the constructed plan,
+    with pairwise different first producers
+*/
+std::vector<MutexGroup> TaskGenerator::generate_binding_mutexes(
+    const TaskGeneratorParams &params, const std::vector<Fact> &goal_state,
+    const std::vector<Action> &actions, const std::vector<Axiom> &axioms) {
+    std::vector<MutexGroup> mutexes;
+    if (params.n_binding_mutex <= 0) return mutexes;
+    std::vector<std::vector<bool>> needed =
+        plan_facts(goal_state, actions, axioms);
+    std::vector<Fact> off_plan;
+    for (const Fact &f : this->reached_facts)
+        if (this->producer[f.var_idx][f.var_val] != -1 &&
+            !needed[f.var_idx][f.var_val])
+            off_plan.push_back(f);
+    if (off_plan.size() < 2) return mutexes;
+
+    for (int i = 0; i < params.n_binding_mutex; i++) {
+        MutexGroup mutex;
+        std::vector<int> producers;
+        for (int tries = 0;
+             mutex.facts.size() < params.mutex_size &&
+             tries < 4 * params.mutex_size;
+             tries++) {
+            Fact f = off_plan[random_int(0, off_plan.size() - 1)];
+            int p = this->producer[f.var_idx][f.var_val];
+            if (std::find(producers.begin(), producers.end(), p) !=
+                producers.end())
+                continue;
+            producers.push_back(p);
+            mutex.facts.push_back(f);
+        }
+        if (mutex.facts.size() < 2) continue;
+        mutex.n_facts = mutex.facts.size();
+        mutexes.push_back(mutex);
+    }
+    return mutexes;
+}
+
+PlanningTask TaskGenerator::generate(const TaskGeneratorParams &params) {
+    this->gen.seed(params.seed);
+    this->vars.clear();
+    this->reached.clear();
+    this->producer.clear();
+    this->reached_facts.clear();
+
+    int n_derived = params.n_axiom_layers * params.derived_per_layer;
+    for (int i = 0; i < params.n_vars + n_derived; i++) {
+        Variable var;
+        if (i < params.n_vars) {
+            var.name = "var" + std::to_string(i);
+            var.axiom_layer = -1;
+            var.range = random_int(std::max(2, params.min_range),
+                                   std::max(2, params.max_range));
+        } else {
+            var.name = "derived" + std::to_string(i - params.n_vars);
+            var.axiom_layer = (i - params.n_vars) / params.derived_per_layer;
+            var.range = 2;
+        }
+        for (int val = 0; val < var.range; val++)
+            var.sym_names.push_back("Atom " + var.name + "(" +
+                                    std::to_string(val) + ")");
+        this->vars.push_back(var);
+        this->reached.push_back(std::vector<bool>(var.range, false));
+        this->producer.push_back(std::vector<int>(var.range, -1));
+    }
+
+    std::vector<int> initial_state(this->vars.size(), 0);
+    for (int i = 0; i < this->vars.size(); i++)
+        if (i < params.n_vars) reach({i, 0});
+
+    // axiom layers are interleaved with the actions, so that later actions
+    // can require derived facts
+    std::vector<Action> actions;
+    std::vector<Axiom> axioms;
+    int layer = 0;
+    for (int i = 0; i < params.n_actions; i++) {
+        while (layer < params.n_axiom_layers &&
+               i >= (layer + 1) * params.n_actions /
+                        (params.n_axiom_layers + 1)) {
+            std::vector<Axiom> layer_axioms =
+                generate_axiom_layer(layer, params);
+            axioms.insert(axioms.end(), layer_axioms.begin(),
+                          layer_axioms.end());
+            layer++;
+        }
+        actions.push_back(generate_action(i, params));
+    }
+    for (; layer < params.n_axiom_layers; layer++) {
+        std::vector<Axiom> layer_axioms = generate_axiom_layer(layer, params);
+        axioms.insert(axioms.end(), layer_axioms.begin(), layer_axioms.end());
+    }
+
+    // goals: reached facts of regular variables not true initially
+    std::vector<Fact> candidates;
+    for (Fact &f : this->reached_facts)
+        if (f.var_idx < params.n_vars && f.var_val != 0)
+            candidates.push_back(f);
+    std::shuffle(candidates.begin(), candidates.end(), this->gen);
+    std::vector<Fact> goal_state;
+    std::vector<bool> goal_var(params.n_vars, false);
+    for (Fact &f : candidates) {
+        if (goal_state.size() == params.n_goals) break;
+        if (goal_var[f.var_idx]) continue;
+        goal_var[f.var_idx] = true;
+        goal_state.push_back(f);
+    }
+
+    // mutex groups: one reachable fact plus facts no action produces, so
+    // they are checked on every update but never make the task unsolvable
+    std::vector<Fact> unreached;
+    for (int var = 0; var < params.n_vars; var++)
+        for (int val = 0; val < this->vars[var].range; val++)
+            if (!this->reached[var][val]) unreached.push_back({var, val});
+    std::vector<MutexGroup> mutexes;
+    for (int i = 0; i < params.n_mutex; i++) {
+        MutexGroup mutex;
+        mutex.facts.push_back(this->reached_facts[random_int(
+            0, this->reached_facts.size() - 1)]);
+        for (int j = 1; j < params.mutex_size && !unreached.empty(); j++) {
+            Fact f = unreached[random_int(0, unreached.size() - 1)];
+            if (std::find(mutex.facts.begin(), mutex.facts.end(), f) ==
+                mutex.facts.end())
+                mutex.facts.push_back(f);
+        }
+        mutex.n_facts = mutex.facts.size();
+        mutexes.push_back(mutex);
+    }
+    std::vector<MutexGroup> binding =
+        generate_binding_mutexes(params, goal_state, actions, axioms);
+    mutexes.insert(mutexes.end(), binding.begin(), binding.end());
+
+    int metric = params.cost_distribution == CostDistribution::unit ? 0 : 1;
+    return PlanningTask(metric, this->vars.size(), this->vars, mutexes.size(),
+                        mutexes, initial_state, goal_state.size(), goal_state,
+                        actions.size(), actions, axioms.size(), axioms);
+}
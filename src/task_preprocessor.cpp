@@ -0,0 +1,510 @@
+#include "../include/task_preprocessor.h"
+
+#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+int TaskPreprocessor::fact_id(const Fact &fact) {
+    return fact.var_val == -1 ? -1 : this->var_offset[fact.var_idx] +
+                                         fact.var_val;
+}
+
+void TaskPreprocessor::build_units(std::vector<Variable> &vars,
+                                   std::vector<Action> &actions,
+                                   std::vector<Axiom> &axioms) {
+    this->var_offset.assign(vars.size() + 1, 0);
+    for (int var = 0; var < vars.size(); var++)
+        this->var_offset[var + 1] = this->var_offset[var] + vars[var].range;
+    this->n_facts = this->var_offset[vars.size()];
+    this->fact_var.clear();
+    for (int var = 0; var < vars.size(); var++)
+        for (int val = 0; val < vars[var].range; val++)
+            this->fact_var.push_back(var);
+
+    this->unit_conds.clear();
+    this->unit_target.clear();
+    this->unit_owner.clear();
+    for (int i = 0; i < actions.size(); i++) {
+        std::vector<int> preconds;
+        for (const Fact &pre : actions[i].preconds)
+            if (pre.var_val != -1) preconds.push_back(fact_id(pre));
+        for (const Effect &effect : actions[i].effects) {
+            std::vector<int> conds = preconds;
+            for (const Fact &cond : effect.effect_conds)
+                if (cond.var_val != -1) conds.push_back(fact_id(cond));
+            if (effect.from_value != -1)
+                conds.push_back(
+                    fact_id({effect.var_affected, effect.from_value}));
+            this->unit_conds.push_back(conds);
+            this->unit_target.push_back(
+                fact_id({effect.var_affected, effect.to_value}));
+            this->unit_owner.push_back(i);
+        }
+    }
+    for (int i = 0; i < axioms.size(); i++) {
+        const Axiom &axiom = axioms[i];
+        std::vector<int> conds;
+        for (const Fact &cond : axiom.conds)
+            if (cond.var_val != -1) conds.push_back(fact_id(cond));
+        if (axiom.from_value != -1)
+            conds.push_back(fact_id({axiom.affected_var, axiom.from_value}));
+        this->unit_conds.push_back(conds);
+        this->unit_target.push_back(
+            fact_id({axiom.affected_var, axiom.to_value}));
+        this->unit_owner.push_back(actions.size() + i);
+    }
+    this->n_units = this->unit_target.size();
+
+    this->fact_watchers.assign(this->n_facts, std::vector<int>());
+    this->fact_achievers.assign(this->n_facts, std::vector<int>());
+    for (int u = 0; u < this->n_units; u++) {
+        for (int cond : this->unit_conds[u])
+            this->fact_watchers[cond].push_back(u);
+        this->fact_achievers[this->unit_target[u]].push_back(u);
+    }
+}
+
+/*
+    delete-relaxed forward reachability from the initial state, counting
+    for each unit the conditions still missing
+*/
+void TaskPreprocessor::compute_reachability(std::vector<int> &initial_state) {
+    this->reached.assign(this->n_facts, 0);
+    this->unit_reached.assign(this->n_units, 0);
+    std::vector<int> missing(this->n_units);
+    std::vector<int> queue;
+
+    for (int var = 0; var < initial_state.size(); var++) {
+        int f = this->var_offset[var] + initial_state[var];
+        this->reached[f] = 1;
+        queue.push_back(f);
+    }
+    for (int u = 0; u < this->n_units; u++) {
+        missing[u] = this->unit_conds[u].size();
+        if (missing[u] == 0 && this->alive[this->unit_owner[u]]) {
+            this->unit_reached[u] = 1;
+            int f = this->unit_target[u];
+            if (!this->reached[f]) {
+                this->reached[f] = 1;
+                queue.push_back(f);
+            }
+        }
+    }
+
+    for (int i = 0; i < queue.size(); i++) {
+        for (int u : this->fact_watchers[queue[i]]) {
+            if (!this->alive[this->unit_owner[u]] || --missing[u] > 0)
+                continue;
+            this->unit_reached[u] = 1;
+            int f = this->unit_target[u];
+            if (!this->reached[f]) {
+                this->reached[f] = 1;
+                queue.push_back(f);
+            }
+        }
+    }
+}
+
+/*
+    backward relevance: goals are relevant, and so are all the conditions of
+    a reachable unit adding a relevant fact
+*/
+void TaskPreprocessor::compute_relevance(std::vector<Fact> &goal_state) {
+    this->relevant.assign(this->n_facts, 0);
+    this->unit_relevant.assign(this->n_units, 0);
+    std::vector<int> queue;
+
+    for (const Fact &goal : goal_state) {
+        int f = fact_id(goal);
+        if (!this->relevant[f]) {
+            this->relevant[f] = 1;
+            queue.push_back(f);
+        }
+    }
+
+    for (int i = 0; i < queue.size(); i++) {
+        for (int u : this->fact_achievers[queue[i]]) {
+            if (!this->alive[this->unit_owner[u]] || !this->unit_reached[u] ||
+                this->unit_relevant[u])
+                continue;
+            this->unit_relevant[u] = 1;
+            for (int cond : this->unit_conds[u]) {
+                if (!this->relevant[cond]) {
+                    this->relevant[cond] = 1;
+                    queue.push_back(cond);
+                }
+            }
+        }
+    }
+}
+
+/*
+    an axiom is kept if it can fire and its outcome matters: it is relevant,
+    it is in a mutex group (it can block other updates) or it is a condition
+    of an effect of a kept action or of another kept axiom
+*/
+std::vector<char> TaskPreprocessor::select_axioms(int n_actions) {
+    std::vector<char> keep(this->alive.size() - n_actions, 0);
+    std::vector<char> needed(this->n_facts, 0);
+    std::vector<int> queue;
+
+    for (int f = 0; f < this->n_facts; f++)
+        if (this->relevant[f] || this->in_mutex[f]) needed[f] = 1;
+    for (int u = 0; u < this->n_units; u++)
+        if (this->unit_owner[u] < n_actions &&
+            this->alive[this->unit_owner[u]] && this->unit_reached[u])
+            for (int cond : this->unit_conds[u]) needed[cond] = 1;
+    for (int f = 0; f < this->n_facts; f++)
+        if (needed[f]) queue.push_back(f);
+
+    for (int i = 0; i < queue.size(); i++) {
+        for (int u : this->fact_achievers[queue[i]]) {
+            int owner = this->unit_owner[u];
+            if (owner < n_actions || !this->alive[owner] ||
+                !this->unit_reached[u] || keep[owner - n_actions])
+                continue;
+            keep[owner - n_actions] = 1;
+            for (int cond : this->unit_conds[u]) {
+                if (!needed[cond]) {
+                    needed[cond] = 1;
+                    queue.push_back(cond);
+                }
+            }
+        }
+    }
+    return keep;
+}
+
+/*
+    actions are compared on normalized signatures: sorted precondition ids
+    and sorted ids of their reachable effects, where equal effects (same
+    conditions, from and to value) share an id. Duplicates are found by
+    indexing the signatures, dominators of an action are only searched among
+    the actions sharing its rarest effect.
+*/
+bool TaskPreprocessor::remove_dominated_actions(int metric,
+                                                std::vector<Action> &actions) {
+    int n_actions = actions.size();
+    std::vector<std::vector<int>> pre(n_actions), eff(n_actions);
+    std::map<std::vector<int>, int> effect_ids;
+    std::vector<int> effect_target;
+    int u = 0;
+    for (int i = 0; i < n_actions; i++) {
+        for (const Effect &effect : actions[i].effects) {
+            if (!this->unit_reached[u++] || !this->alive[i]) continue;
+            std::vector<int> key = {
+                fact_id({effect.var_affected, effect.to_value}),
+                fact_id({effect.var_affected, effect.from_value})};
+            std::vector<int> conds;
+            for (const Fact &cond : effect.effect_conds)
+                if (cond.var_val != -1) conds.push_back(fact_id(cond));
+            std::sort(conds.begin(), conds.end());
+            key.insert(key.end(), conds.begin(), conds.end());
+            auto it = effect_ids.emplace(key, effect_ids.size()).first;
+            if (it->second == effect_target.size())
+                effect_target.push_back(key[0]);
+            eff[i].push_back(it->second);
+        }
+        if (!this->alive[i]) continue;
+        for (const Fact &p : actions[i].preconds)
+            if (p.var_val != -1) pre[i].push_back(fact_id(p));
+        std::sort(pre[i].begin(), pre[i].end());
+        pre[i].erase(std::unique(pre[i].begin(), pre[i].end()), pre[i].end());
+        std::sort(eff[i].begin(), eff[i].end());
+        eff[i].erase(std::unique(eff[i].begin(), eff[i].end()), eff[i].end());
+    }
+
+    // an extra effect is harmless if its outcome is in no mutex group and in
+    // no condition of an axiom
+    std::vector<char> axiom_cond(this->n_facts, 0);
+    for (int v = 0; v < this->n_units; v++)
+        if (this->unit_owner[v] >= n_actions &&
+            this->alive[this->unit_owner[v]])
+            for (int cond : this->unit_conds[v]) axiom_cond[cond] = 1;
+    std::vector<char> unsafe(effect_target.size());
+    for (int e = 0; e < effect_target.size(); e++)
+        unsafe[e] = this->in_mutex[effect_target[e]] ||
+                    axiom_cond[effect_target[e]];
+
+    auto cost = [&](int i) { return metric == 1 ? actions[i].cost : 1; };
+    bool removed = false;
+
+    // duplicates: keep the cheapest, then the first
+    std::map<std::pair<std::vector<int>, std::vector<int>>, int> signatures;
+    for (int i = 0; i < n_actions; i++) {
+        if (!this->alive[i]) continue;
+        auto it = signatures.emplace(std::make_pair(pre[i], eff[i]), i).first;
+        if (it->second == i) continue;
+        int removed_idx = i;
+        if (cost(i) < cost(it->second)) {
+            removed_idx = it->second;
+            it->second = i;
+        }
+        this->alive[removed_idx] = 0;
+        this->n_duplicate_actions++;
+        removed = true;
+    }
+
+    std::vector<std::vector<int>> effect_actions(effect_target.size());
+    std::vector<int> candidates;
+    for (int i = 0; i < n_actions; i++) {
+        if (!this->alive[i]) continue;
+        candidates.push_back(i);
+        for (int e : eff[i]) effect_actions[e].push_back(i);
+    }
+
+    // a dominated action is removed even if its dominator is removed too:
+    // dominance is transitive, so some dominator is always kept
+    for (int b : candidates) {
+        int rarest = eff[b][0];
+        for (int e : eff[b])
+            if (effect_actions[e].size() < effect_actions[rarest].size())
+                rarest = e;
+        for (int a : effect_actions[rarest]) {
+            if (a == b || cost(a) > cost(b) ||
+                pre[a].size() > pre[b].size() ||
+                eff[a].size() < eff[b].size() ||
+                !std::includes(pre[b].begin(), pre[b].end(), pre[a].begin(),
+                               pre[a].end()) ||
+                !std::includes(eff[a].begin(), eff[a].end(), eff[b].begin(),
+                               eff[b].end()))
+                continue;
+            bool safe = true;
+            for (int e : eff[a])
+                if (unsafe[e] &&
+                    !std::binary_search(eff[b].begin(), eff[b].end(), e))
+                    safe = false;
+            if (!safe) continue;
+            this->alive[b] = 0;
+            this->n_dominated_actions++;
+            removed = true;
+            break;
+        }
+    }
+    return removed;
+}
+
+void TaskPreprocessor::run(int metric, std::vector<Variable> &vars,
+                           std::vector<MutexGroup> &mutexes,
+                           std::vector<int> &initial_state,
+                           std::vector<Fact> &goal_state,
+                           std::vector<Action> &actions,
+                           std::vector<Axiom> &axioms) {
+    int n_actions = actions.size();
+    this->goal_unreachable = false;
+    this->n_actions_before = n_actions;
+    this->n_axioms_before = axioms.size();
+    this->n_vars_before = vars.size();
+    this->n_mutex_before = mutexes.size();
+    this->n_unreachable_actions = this->n_irrelevant_actions = 0;
+    this->n_duplicate_actions = this->n_dominated_actions = 0;
+    this->n_unreachable_axioms = this->n_irrelevant_axioms = 0;
+
+    build_units(vars, actions, axioms);
+    this->n_facts_before = this->n_facts;
+    this->in_mutex.assign(this->n_facts, 0);
+    for (const MutexGroup &mutex : mutexes)
+        for (const Fact &f : mutex.facts) this->in_mutex[fact_id(f)] = 1;
+
+    this->alive.assign(n_actions + axioms.size(), 1);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        compute_reachability(initial_state);
+        for (const Fact &goal : goal_state)
+            if (!this->reached[fact_id(goal)]) this->goal_unreachable = true;
+        if (this->goal_unreachable) break;  // leave the task as it is
+        compute_relevance(goal_state);
+
+        std::vector<char> owner_reached(this->alive.size(), 0);
+        std::vector<char> owner_relevant(this->alive.size(), 0);
+        for (int u = 0; u < this->n_units; u++) {
+            owner_reached[this->unit_owner[u]] |= this->unit_reached[u];
+            owner_relevant[this->unit_owner[u]] |= this->unit_relevant[u];
+        }
+        for (int i = 0; i < n_actions; i++) {
+            if (!this->alive[i] || owner_relevant[i]) continue;
+            this->alive[i] = 0;
+            if (owner_reached[i])
+                this->n_irrelevant_actions++;
+            else
+                this->n_unreachable_actions++;
+            changed = true;
+        }
+        if (this->remove_dominated &&
+            remove_dominated_actions(metric, actions))
+            changed = true;
+
+        std::vector<char> keep = select_axioms(n_actions);
+        for (int i = 0; i < axioms.size(); i++) {
+            if (!this->alive[n_actions + i] || keep[i]) continue;
+            this->alive[n_actions + i] = 0;
+            if (owner_reached[n_actions + i])
+                this->n_irrelevant_axioms++;
+            else
+                this->n_unreachable_axioms++;
+            changed = true;
+        }
+    }
+
+    if (this->goal_unreachable) {
+        this->n_unreachable_actions = this->n_irrelevant_actions = 0;
+        this->n_duplicate_actions = this->n_dominated_actions = 0;
+        this->n_unreachable_axioms = this->n_irrelevant_axioms = 0;
+    } else {
+        compact(vars, mutexes, initial_state, goal_state, actions, axioms);
+    }
+
+    this->n_actions_after = actions.size();
+    this->n_axioms_after = axioms.size();
+    this->n_vars_after = vars.size();
+    this->n_mutex_after = mutexes.size();
+    this->n_facts_after = 0;
+    for (const Variable &var : vars) this->n_facts_after += var.range;
+}
+
+/*
+    rewrite the task keeping only live actions, reached effects and reached
+    values. A variable is dropped when a single value is reachable (the
+    initial one) and nothing adds it, needs it as a goal or lists it in a
+    mutex group: conditions on it always hold and can be removed.
+*/
+void TaskPreprocessor::compact(std::vector<Variable> &vars,
+                               std::vector<MutexGroup> &mutexes,
+                               std::vector<int> &initial_state,
+                               std::vector<Fact> &goal_state,
+                               std::vector<Action> &actions,
+                               std::vector<Axiom> &axioms) {
+    int n_actions = actions.size();
+
+    // mutex groups: facts that never become true cannot block anything
+    std::vector<MutexGroup> new_mutexes;
+    for (const MutexGroup &mutex : mutexes) {
+        MutexGroup new_mutex;
+        for (const Fact &f : mutex.facts)
+            if (this->reached[fact_id(f)]) new_mutex.facts.push_back(f);
+        new_mutex.n_facts = new_mutex.facts.size();
+        if (new_mutex.n_facts) new_mutexes.push_back(new_mutex);
+    }
+
+    std::vector<char> keep_var(vars.size(), 0);
+    for (int u = 0; u < this->n_units; u++)
+        if (this->alive[this->unit_owner[u]] && this->unit_reached[u])
+            keep_var[this->fact_var[this->unit_target[u]]] = 1;
+    for (const Fact &goal : goal_state) keep_var[goal.var_idx] = 1;
+    for (const MutexGroup &mutex : new_mutexes)
+        for (const Fact &f : mutex.facts) keep_var[f.var_idx] = 1;
+
+    std::vector<int> new_var(vars.size(), -1);
+    std::vector<std::vector<int>> new_val(vars.size());
+    std::vector<Variable> new_vars;
+    for (int var = 0; var < vars.size(); var++) {
+        Variable new_variable = vars[var];
+        new_variable.sym_names.clear();
+        new_val[var].assign(vars[var].range, -1);
+        for (int val = 0; val < vars[var].range; val++) {
+            if (!this->reached[this->var_offset[var] + val]) continue;
+            new_val[var][val] = new_variable.sym_names.size();
+            new_variable.sym_names.push_back(vars[var].sym_names[val]);
+        }
+        new_variable.range = new_variable.sym_names.size();
+        if (new_variable.range > 1) keep_var[var] = 1;
+        if (!keep_var[var]) continue;
+        new_var[var] = new_vars.size();
+        new_vars.push_back(new_variable);
+    }
+
+    auto map_fact = [&](const Fact &f) -> Fact {
+        return {new_var[f.var_idx],
+                f.var_val == -1 ? -1 : new_val[f.var_idx][f.var_val]};
+    };
+    // conditions on dropped variables always hold
+    auto map_conds = [&](const std::vector<Fact> &conds) {
+        std::vector<Fact> new_conds;
+        for (const Fact &f : conds)
+            if (new_var[f.var_idx] != -1) new_conds.push_back(map_fact(f));
+        return new_conds;
+    };
+
+    for (MutexGroup &mutex : new_mutexes)
+        for (Fact &f : mutex.facts) f = map_fact(f);
+
+    std::vector<int> new_initial_state;
+    for (int var = 0; var < vars.size(); var++)
+        if (new_var[var] != -1)
+            new_initial_state.push_back(new_val[var][initial_state[var]]);
+
+    for (Fact &goal : goal_state) goal = map_fact(goal);
+
+    // units are numbered action by action, effect by effect, then axioms
+    std::vector<Action> new_actions;
+    int u = 0;
+    for (int i = 0; i < n_actions; i++) {
+        const Action &action = actions[i];
+        if (!this->alive[i]) {
+            u += action.n_effects;
+            continue;
+        }
+        Action new_action = action;
+        new_action.preconds = map_conds(action.preconds);
+        new_action.n_preconds = new_action.preconds.size();
+        new_action.effects.clear();
+        for (const Effect &effect : action.effects) {
+            if (!this->unit_reached[u++]) continue;  // it never fires
+            Effect new_effect = effect;
+            new_effect.effect_conds = map_conds(effect.effect_conds);
+            new_effect.n_effect_conds = new_effect.effect_conds.size();
+            Fact from = map_fact({effect.var_affected, effect.from_value});
+            Fact to = map_fact({effect.var_affected, effect.to_value});
+            new_effect.var_affected = to.var_idx;
+            new_effect.from_value = from.var_val;
+            new_effect.to_value = to.var_val;
+            new_action.effects.push_back(new_effect);
+        }
+        new_action.n_effects = new_action.effects.size();
+        new_actions.push_back(new_action);
+    }
+
+    std::vector<Axiom> new_axioms;
+    for (int i = 0; i < axioms.size(); i++) {
+        if (!this->alive[n_actions + i]) continue;
+        Axiom new_axiom = axioms[i];
+        new_axiom.conds = map_conds(axioms[i].conds);
+        new_axiom.n_conds = new_axiom.conds.size();
+        Fact from = map_fact({axioms[i].affected_var, axioms[i].from_value});
+        Fact to = map_fact({axioms[i].affected_var, axioms[i].to_value});
+        new_axiom.affected_var = to.var_idx;
+        new_axiom.from_value = from.var_val;
+        new_axiom.to_value = to.var_val;
+        new_axioms.push_back(new_axiom);
+    }
+
+    vars.swap(new_vars);
+    mutexes.swap(new_mutexes);
+    initial_state.swap(new_initial_state);
+    actions.swap(new_actions);
+    axioms.swap(new_axioms);
+}
+
+void TaskPreprocessor::print_report(std::ostream &out) {
+    if (this->goal_unreachable) {
+        out << "Goal unreachable under delete relaxation, task left unchanged"
+            << std::endl;
+        return;
+    }
+    out << "Actions: " << this->n_actions_before << " -> "
+        << this->n_actions_after << " (" << this->n_unreachable_actions
+        << " unreachable, " << this->n_irrelevant_actions << " irrelevant, "
+        << this->n_duplicate_actions << " duplicate, "
+        << this->n_dominated_actions << " dominated)" << std::endl;
+    out << "Axioms: " << this->n_axioms_before << " -> " << this->n_axioms_after
+        << " (" << this->n_unreachable_axioms << " unreachable, "
+        << this->n_irrelevant_axioms << " irrelevant)" << std::endl;
+    out << "Variables: " << this->n_vars_before << " -> " << this->n_vars_after
+        << std::endl;
+    out << "Facts: " << this->n_facts_before << " -> " << this->n_facts_after
+        << std::endl;
+    out << "Mutexes: " << this->n_mutex_before << " -> " << this->n_mutex_after
+        << std::endl;
+}
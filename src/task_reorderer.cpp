@@ -0,0 +1,107 @@
+#include "../include/task_reorderer.h"
+
+#include <queue>
+#include <utility>
+#include <vector>
+
+void TaskReorderer::compute_order(int n_vars,
+                                  const std::vector<Fact> &goal_state,
+                                  const std::vector<Action> &actions,
+                                  const std::vector<Axiom> &axioms) {
+    // var -> actions and axioms changing it
+    std::vector<std::vector<int>> var_actions(n_vars), var_axioms(n_vars);
+    for (int i = 0; i < actions.size(); i++) {
+        for (const Effect &effect : actions[i].effects) {
+            std::vector<int> &achievers = var_actions[effect.var_affected];
+            if (achievers.empty() || achievers.back() != i)
+                achievers.push_back(i);
+        }
+    }
+    for (int i = 0; i < axioms.size(); i++)
+        var_axioms[axioms[i].affected_var].push_back(i);
+
+    this->var_order.clear();
+    this->action_order.clear();
+    std::vector<char> var_seen(n_vars, 0), action_seen(actions.size(), 0);
+    std::queue<int> open;
+    auto reach = [&](int var) {
+        if (var_seen[var]) return;
+        var_seen[var] = 1;
+        open.push(var);
+    };
+    auto visit = [&]() {
+        while (!open.empty()) {
+            int var = open.front();
+            open.pop();
+            this->var_order.push_back(var);
+            for (int a : var_actions[var]) {
+                if (action_seen[a]) continue;
+                action_seen[a] = 1;
+                this->action_order.push_back(a);
+                for (const Fact &pre : actions[a].preconds) reach(pre.var_idx);
+                for (const Effect &effect : actions[a].effects) {
+                    for (const Fact &cond : effect.effect_conds)
+                        reach(cond.var_idx);
+                    reach(effect.var_affected);
+                }
+            }
+            for (int x : var_axioms[var])
+                for (const Fact &cond : axioms[x].conds) reach(cond.var_idx);
+        }
+    };
+
+    for (const Fact &goal : goal_state) reach(goal.var_idx);
+    visit();
+    for (int var = 0; var < n_vars; var++) {
+        reach(var);
+        visit();
+    }
+    // actions without effects change no variable
+    for (int a = 0; a < actions.size(); a++)
+        if (!action_seen[a]) this->action_order.push_back(a);
+}
+
+void TaskReorderer::run(std::vector<Variable> &vars,
+                        std::vector<MutexGroup> &mutexes,
+                        std::vector<int> &initial_state,
+                        std::vector<Fact> &goal_state,
+                        std::vector<Action> &actions,
+                        std::vector<Axiom> &axioms) {
+    compute_order(vars.size(), goal_state, actions, axioms);
+
+    std::vector<int> new_var(vars.size());
+    for (int i = 0; i < vars.size(); i++) new_var[this->var_order[i]] = i;
+    auto map_facts = [&](std::vector<Fact> &facts) {
+        for (Fact &f : facts) f.var_idx = new_var[f.var_idx];
+    };
+
+    std::vector<Variable> new_vars;
+    std::vector<int> new_initial_state;
+    for (int var : this->var_order) {
+        new_vars.push_back(std::move(vars[var]));
+        new_initial_state.push_back(initial_state[var]);
+    }
+
+    for (MutexGroup &mutex : mutexes) map_facts(mutex.facts);
+    map_facts(goal_state);
+
+    std::vector<Action> new_actions;
+    for (int a : this->action_order) {
+        new_actions.push_back(std::move(actions[a]));
+        Action &action = new_actions.back();
+        map_facts(action.preconds);
+        for (Effect &effect : action.effects) {
+            map_facts(effect.effect_conds);
+            effect.var_affected = new_var[effect.var_affected];
+        }
+    }
+
+    for (Axiom &axiom : axioms) {
+        map_facts(axiom.conds);
+        axiom.affected_var = new_var[axiom.affected_var];
+    }
+
+    vars.swap(new_vars);
+    initial_state.swap(new_initial_state);
+    actions.swap(new_actions);
+}
@@ -0,0 +1,54 @@
+#include "../include/worker_pool.h"
+
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+WorkerPool::WorkerPool(int n_workers) {
+    for (int i = 0; i < n_workers; i++)
+        this->workers.emplace_back(&WorkerPool::run, this);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->job_ready.notify_all();
+    for (std::thread &worker : this->workers) worker.join();
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back(std::move(job));
+    }
+    this->job_ready.notify_one();
+}
+
+void WorkerPool::wait() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->idle.wait(lock, [this]() {
+        return this->jobs.empty() && this->n_running == 0;
+    });
+}
+
+void WorkerPool::run() {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    while (true) {
+        this->job_ready.wait(lock, [this]() {
+            return this->stopping || !this->jobs.empty();
+        });
+        if (this->jobs.empty()) return;  // stopping
+        std::function<void()> job = std::move(this->jobs.front());
+        this->jobs.pop_front();
+        this->n_running++;
+        lock.unlock();
+        job();
+        lock.lock();
+        this->n_running--;
+        if (this->jobs.empty() && this->n_running == 0)
+            this->idle.notify_all();
+    }
+}
@@ -0,0 +1,103 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "include/plan_validator.h"
+#include "include/planning_task.h"
+#include "include/planning_task_parser.h"
+
+void print_usage(std::string executable) {
+    std::cerr << "Usage: " << executable
+              << " --from-file <file_name> [--plan <file_name>]" << std::endl;
+    std::cerr << std::endl
+              << "Validates a plan (stdin if no --plan is given) on the task. "
+                 "The plan is the output of main, or one \"<action_idx>: "
+                 "<action_name>\" line per step with an optional \"Cost: "
+                 "<int>\" line"
+              << std::endl;
+}
+
+int main(int argc, char **argv) {
+    std::string file_name, plan_name;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 2;
+        }
+        if (arg == "--from-file") {
+            file_name = argv[++i];
+        } else if (arg == "--plan") {
+            plan_name = argv[++i];
+        } else {
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (file_name.empty()) {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    // no preprocessing: the action indices are the ones of the file
+    PlanningTaskParser parser;
+    PlanningTask pt = parser.parse_from_file(file_name);
+
+    std::ifstream plan_file;
+    if (!plan_name.empty()) {
+        plan_file.open(plan_name);
+        if (!plan_file.is_open()) {
+            std::cerr << "Failed to open " << plan_name << std::endl;
+            return 2;
+        }
+    }
+    std::istream &in = plan_name.empty() ? std::cin : plan_file;
+
+    // with the output of main, only the last solution counts
+    std::vector<int> plan;
+    std::vector<std::string> names;
+    int cost = -1;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line == "############### Solution ###############") {
+            plan.clear();
+            names.clear();
+            cost = -1;
+            continue;
+        }
+        std::istringstream ss(line);
+        int value;
+        std::string word;
+        if (line.compare(0, 6, "Cost: ") == 0) {
+            ss >> word >> cost;
+        } else if (ss >> value && ss.get() == ':' && ss.get() == ' ') {
+            plan.push_back(value);
+            std::getline(ss, word);
+            names.push_back(word);
+        }
+    }
+
+    // the names catch plans written for another task (or preprocessed)
+    for (int k = 0; k < plan.size(); k++) {
+        if (plan[k] < 0 || plan[k] >= pt.core->n_actions) break;
+        std::string name = pt.core->action_name(plan[k]);
+        if (names[k] != name) {
+            std::cout << "Plan NOT valid! Step " << k << ": action "
+                      << plan[k] << " is " << name << ", not " << names[k]
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    PlanValidator validator(*pt.core);
+    if (validator.validate(pt.initial_state, pt.goal_state, plan, cost)) {
+        std::cout << "Plan valid! Steps: " << plan.size()
+                  << ", cost: " << validator.cost << std::endl;
+        return 0;
+    }
+    std::cout << "Plan NOT valid! Step " << validator.failed_step << ": "
+              << validator.error << std::endl;
+    return 1;
+}